@@ -133,7 +133,8 @@ MRI_DIR  = $(BUILD_DIR)/../mri
 
 # Include path which points to external library headers and to subdirectories of this project which contain headers.
 SUBDIRS = $(wildcard $(SRC)/* $(SRC)/*/* $(SRC)/*/*/* $(SRC)/*/*/*/* $(SRC)/*/*/*/*/*)
-PROJINCS = $(sort $(dir $(SUBDIRS)))
+# src/testframework/host has fake hardware headers for the PC build, they must never be found by the firmware
+PROJINCS = $(filter-out $(SRC)/testframework/host/%,$(sort $(dir $(SUBDIRS))))
 INCDIRS += $(SRC) $(PROJINCS) $(MRI_DIR) $(MBED_DIR) $(MBED_DIR)/$(DEVICE)
 
 # DEFINEs to be used when building C/C++ code
@@ -76,7 +76,7 @@ void FileConfigSource::transfer_values_to_cache( ConfigCache *cache, const char
             ConfigValue* cv = process_line_from_ascii_config(line, cache);
 
             // if this line is an include directive then attempt to read the included file
-            if(cv->check_sums[0] == include_checksum) {
+            if(cv != NULL && cv->check_sums[0] == include_checksum) {
                 string inc_file_name = cv->value.c_str();
                 if(!file_exists(inc_file_name)) {
                     // if the file is not found at the location entered then look around for it a bit
@@ -135,10 +135,10 @@ bool FileConfigSource::write( string setting, string value )
     // search each line for a match
     while(!feof(lp)) {
         string line;
-        fpos_t bol, eol;
-        fgetpos( lp, &bol ); // get start of line
+        long bol, eol;
+        bol = ftell(lp); // get start of line
         if(readLine(line, 0, lp)) {
-            fgetpos( lp, &eol ); // get end of line
+            eol = ftell(lp); // get end of line
             if(!process_line_from_ascii_config(line, setting_checksums).empty()) {
                 // found it
                 unsigned int free_space = eol - bol - 4; // length of line
@@ -0,0 +1,128 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifdef EVENT_PROFILE
+
+#include "EventProfiler.h"
+#include "StreamOutput.h"
+#include "system_LPC17xx.h"
+#include "us_ticker_api.h"
+
+#include <algorithm>
+
+// the handler address is got from the member function pointer, a GCC extension
+#pragma GCC diagnostic ignored "-Wpmf-conversions"
+
+// in the order of _EVENT_ENUM
+static const char *event_names[NUMBER_OF_DEFINED_EVENTS] = {
+    "on_main_loop",
+    "on_console_line_received",
+    "on_gcode_received",
+    "on_gcode_execute",
+    "on_speed_change",
+    "on_block_begin",
+    "on_block_end",
+    "on_idle",
+    "on_second_tick",
+    "on_get_public_data",
+    "on_set_public_data",
+    "on_halt",
+    "on_enable",
+};
+
+EventProfiler::EventProfiler()
+{
+    // start the cycle counter, MRI may have already
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    reset();
+}
+
+// Called when a module registers for an event, so the entries are never allocated while recording
+void EventProfiler::add(_EVENT_ENUM event, Module *module)
+{
+    std::vector<Entry> &list = entries[event];
+    for (auto &e : list) {
+        if(e.module == module) return;
+    }
+    // an interrupt may be recording into the list while it is reallocated
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    list.push_back({module, 0, 0, 0});
+    __set_PRIMASK(primask);
+}
+
+EventProfiler::Entry *EventProfiler::entry(_EVENT_ENUM event, Module *module)
+{
+    std::vector<Entry> &list = entries[event];
+    size_t i = next[event];
+    if(i >= list.size() || list[i].module != module) {
+        for (i = 0; i < list.size() && list[i].module != module; i++) ;
+        if(i == list.size()) return nullptr;
+    }
+    next[event] = i + 1 < list.size() ? i + 1 : 0;
+    return &list[i];
+}
+
+// the main loop and the interrupts record into the same entries, and print() and reset() read and clear them
+void EventProfiler::record(_EVENT_ENUM event, Module *module, uint32_t cycles)
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    Entry *e = entry(event, module);
+    if(e != nullptr) {
+        e->calls++;
+        e->total += cycles;
+        if(cycles > e->max) e->max = cycles;
+    }
+    __set_PRIMASK(primask);
+}
+
+// One line per module and event, the handler is the address of the module's method, arm-none-eabi-addr2line -fCe main.elf
+// gives its name. The percentage is of the time since the last reset
+void EventProfiler::print(StreamOutput *stream)
+{
+    // a snapshot taken with the interrupts masked, printing takes too long to do that while reading the entries. The lists
+    // only change size in the main loop, so the copies are allocated first
+    std::array<std::vector<Entry>, NUMBER_OF_DEFINED_EVENTS> snapshot;
+    for (int ev = 0; ev < NUMBER_OF_DEFINED_EVENTS; ev++) snapshot[ev].resize(entries[ev].size());
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (int ev = 0; ev < NUMBER_OF_DEFINED_EVENTS; ev++) std::copy(entries[ev].begin(), entries[ev].end(), snapshot[ev].begin());
+    float elapsed_us = us_ticker_read() - reset_us;
+    __set_PRIMASK(primask);
+
+    float cycles_per_us = SystemCoreClock / 1000000.0F;
+    stream->printf("event                    module     handler      calls   total ms   mean us    max us      %%\n");
+    for (int ev = 0; ev < NUMBER_OF_DEFINED_EVENTS; ev++) {
+        for (auto &e : snapshot[ev]) {
+            if(e.calls == 0) continue;
+            void *handler = (void *)(e.module->*kernel_callback_functions[ev]);
+            stream->printf("%-24s %p %p %9lu %10.1f %9.1f %9.1f %6.2f\n", event_names[ev], e.module, handler, (unsigned long)e.calls,
+                           e.total / cycles_per_us / 1000.0F, e.total / cycles_per_us / e.calls, e.max / cycles_per_us, e.total / cycles_per_us * 100.0F / elapsed_us);
+        }
+    }
+}
+
+// the entries are kept, only their counts are cleared
+void EventProfiler::reset()
+{
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    for (auto &list : entries) {
+        for (auto &e : list) {
+            e.calls = 0;
+            e.max = 0;
+            e.total = 0;
+        }
+    }
+    next.fill(0);
+    reset_us = us_ticker_read();
+    __set_PRIMASK(primask);
+}
+
+#endif // EVENT_PROFILE
@@ -0,0 +1,55 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVENTPROFILER_H
+#define EVENTPROFILER_H
+
+// Only in a profiling build, make EVENT_PROFILE=1
+#ifdef EVENT_PROFILE
+
+#include "Module.h"
+#include "LPC17xx.h"
+
+#include <array>
+#include <vector>
+#include <stdint.h>
+
+class StreamOutput;
+
+// How long each module takes to handle each event, timed with the DWT cycle counter around every handler the kernel calls.
+// The time of a handler includes any events it calls itself, eg on_gcode_received calling ON_GCODE_EXECUTE.
+// Events are called from the step interrupts too, so the entries are made when a module registers for an event, in the
+// main loop, and recording only updates one with the interrupts masked
+class EventProfiler {
+    public:
+        EventProfiler();
+
+        static uint32_t cycles() { return DWT->CYCCNT; }
+        void add(_EVENT_ENUM event, Module *module);
+        void record(_EVENT_ENUM event, Module *module, uint32_t cycles);
+        void print(StreamOutput *stream);
+        void reset();
+
+    private:
+        struct Entry {
+            Module *module;
+            uint32_t calls;
+            uint32_t max;
+            uint64_t total;
+        };
+        Entry *entry(_EVENT_ENUM event, Module *module);
+
+        // the modules of each event in the order they registered, the kernel calls them in the same order so next is usually
+        // the one after the last
+        std::array<std::vector<Entry>, NUMBER_OF_DEFINED_EVENTS> entries;
+        std::array<uint8_t, NUMBER_OF_DEFINED_EVENTS> next;
+        uint32_t reset_us;
+};
+
+#endif // EVENT_PROFILE
+
+#endif
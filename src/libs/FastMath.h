@@ -0,0 +1,47 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+// Fast single precision versions of the libm arctangents the inverse kinematics call for every segment, the LPC1768
+// has no FPU so each libm call is a long soft float routine. These take one division and a polynomial. The error bounds
+// are checked against libm by the host build's fastmath_test.
+// There is no sqrtf() here, newlib's is an integer routine and refining an estimate to the precision the rotary delta
+// needs takes as many soft float multiplications as it saves.
+
+#define FAST_MATH_PI_2 1.57079632679489661923F
+
+// arctangent of x in [-1, 1], Abramowitz and Stegun 4.4.49, absolute error below 2E-8 radians, 2E-7 in single precision
+static inline float fast_atanf_unit(float x)
+{
+    float x2 = x * x;
+    return x * (1.0F + x2 * (-0.3333314528F + x2 * (0.1999355085F + x2 * (-0.1420889944F + x2 * (0.1065626393F
+             + x2 * (-0.0752896400F + x2 * (0.0429096138F + x2 * (-0.0161657367F + x2 * 0.0028662257F))))))));
+}
+
+// atanf(), absolute error below 2E-7 radians
+static inline float fast_atanf(float x)
+{
+    if(x > 1.0F) return FAST_MATH_PI_2 - fast_atanf_unit(1.0F / x);
+    if(x < -1.0F) return -FAST_MATH_PI_2 - fast_atanf_unit(1.0F / x);
+    return fast_atanf_unit(x);
+}
+
+// atan2f(), absolute error below 3E-7 radians, returns 0 for (0, 0)
+static inline float fast_atan2f(float y, float x)
+{
+    float ax = x < 0.0F ? -x : x;
+    float ay = y < 0.0F ? -y : y;
+    if(ax == 0.0F && ay == 0.0F) return 0.0F;
+
+    float a = ay <= ax ? fast_atanf_unit(ay / ax) : FAST_MATH_PI_2 - fast_atanf_unit(ax / ay);
+    if(x < 0.0F) a = 2.0F * FAST_MATH_PI_2 - a;
+    return y < 0.0F ? -a : a;
+}
+
+#endif
@@ -0,0 +1,144 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "GcodeHandlers.h"
+#include "Module.h"
+#include "Gcode.h"
+
+#ifdef EVENT_PROFILE
+#include "Kernel.h"
+#include "EventProfiler.h"
+#endif
+
+// The table is a sorted array of (key, module) so it takes 8 bytes per registration, G codes are keyed by their number and
+// M codes by theirs plus 0x4000. Each key holds every module its lines go to, the ones that registered for every G or M and
+// for every line included, so a line is sent by walking one run of entries. A key nobody registered for has no run and its
+// lines go to the run of any_g, any_m or any_line instead
+
+uint16_t GcodeHandlers::key(char letter, int code)
+{
+    if(code < 0 || code >= any_g) code = any_g;
+    if(letter == 'G') return code;
+    if(letter == 'M') return 0x4000 | code;
+    return any_line;
+}
+
+// the key a line goes to when its own has no run
+uint16_t GcodeHandlers::fallback(uint16_t key)
+{
+    if(key == any_g || key == any_m || key == any_line) return any_line;
+    return key < 0x4000 ? any_g : any_m;
+}
+
+// index of the first entry of the key, or where it would go
+size_t GcodeHandlers::first(uint16_t key) const
+{
+    size_t lo = 0, hi = entries.size();
+    while(lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if(entries[mid].key < key) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+// index of the first entry of the run the lines of the key go to, or entries.size() if they go nowhere
+size_t GcodeHandlers::run_of(uint16_t key) const
+{
+    while(true) {
+        size_t i = first(key);
+        if(i < entries.size() && entries[i].key == key) return i;
+        if(key == any_line) return entries.size();
+        key = fallback(key);
+    }
+}
+
+// add the module to the end of the run of the key, a new run starts as a copy of the one its lines went to before
+void GcodeHandlers::append(uint16_t key, Module *module)
+{
+    size_t begin = first(key), end = begin;
+    while(end < entries.size() && entries[end].key == key) end++;
+
+    if(begin == end && key != any_line) {
+        std::vector<Entry> copy;
+        size_t from = run_of(key);
+        for (size_t i = from; i < entries.size() && entries[i].key == entries[from].key; i++) {
+            copy.push_back({key, entries[i].module});
+        }
+        entries.insert(entries.begin() + begin, copy.begin(), copy.end());
+        end = begin + copy.size();
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        if(entries[i].module == module) return;
+    }
+    entries.insert(entries.begin() + end, {key, module});
+}
+
+void GcodeHandlers::add(char letter, int code, Module *module)
+{
+    if(letter != 'G' && letter != 'M') return;
+    if(code >= 0) {
+        append(key(letter, code), module);
+        return;
+    }
+
+    // every code of the letter, the ones with a run of their own and the rest
+    uint16_t any = key(letter, -1);
+    uint16_t lowest = letter == 'G' ? 0 : 0x4000;
+    std::vector<uint16_t> keys;
+    for (auto &e : entries) {
+        if(e.key >= lowest && e.key < any && (keys.empty() || keys.back() != e.key)) keys.push_back(e.key);
+    }
+    for (auto k : keys) append(k, module);
+    append(any, module);
+}
+
+void GcodeHandlers::add_all(Module *module)
+{
+    std::vector<uint16_t> keys;
+    for (auto &e : entries) {
+        if(e.key != any_line && (keys.empty() || keys.back() != e.key)) keys.push_back(e.key);
+    }
+    for (auto k : keys) append(k, module);
+    append(any_line, module);
+}
+
+void GcodeHandlers::remove(Module *module)
+{
+    for (size_t i = 0; i < entries.size(); ) {
+        if(entries[i].module == module) entries.erase(entries.begin() + i);
+        else i++;
+    }
+}
+
+bool GcodeHandlers::contains(const Module *module) const
+{
+    for (auto &e : entries) {
+        if(e.module == module) return true;
+    }
+    return false;
+}
+
+// NOTE entries is indexed rather than iterated as a handler may send a line of its own, which walks the table again
+void GcodeHandlers::dispatch(Gcode *gcode) const
+{
+    uint16_t k = gcode->has_g ? key('G', gcode->g) : gcode->has_m ? key('M', gcode->m) : any_line;
+    size_t i = run_of(k);
+    if(i >= entries.size()) return;
+
+    k = entries[i].key;
+    for (; i < entries.size() && entries[i].key == k; i++) {
+#ifdef EVENT_PROFILE
+        uint32_t start = EventProfiler::cycles();
+        entries[i].module->on_gcode_received(gcode);
+        THEKERNEL->event_profiler->record(ON_GCODE_RECEIVED, entries[i].module, EventProfiler::cycles() - start);
+#else
+        entries[i].module->on_gcode_received(gcode);
+#endif
+    }
+}
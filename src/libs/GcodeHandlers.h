@@ -0,0 +1,47 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GCODEHANDLERS_H
+#define GCODEHANDLERS_H
+
+#include <vector>
+#include <stdint.h>
+
+class Module;
+class Gcode;
+
+// The modules each Gcode is sent to on ON_GCODE_RECEIVED, looked up by its G or M number so a line only goes to the modules
+// that handle it. A module registers for a G or M number, for every G or every M, or like any other event for every line,
+// and the modules a line goes to get it in the order they registered
+class GcodeHandlers {
+    public:
+        void add(char letter, int code, Module *module);    // letter is G or M, a code of -1 for every code of the letter
+        void add_all(Module *module);                       // every line, with or without a G or M
+        void remove(Module *module);
+        bool contains(const Module *module) const;
+        void dispatch(Gcode *gcode) const;
+
+    private:
+        static const uint16_t any_g= 0x3FFF;     // the key of the modules a G without any of its own goes to
+        static const uint16_t any_m= 0x7FFF;     // and an M
+        static const uint16_t any_line= 0xFFFF;  // and a line without a G or M
+
+        static uint16_t key(char letter, int code);
+        static uint16_t fallback(uint16_t key);
+        size_t first(uint16_t key) const;
+        size_t run_of(uint16_t key) const;
+        void append(uint16_t key, Module *module);
+
+        // sorted by key, the modules of each key in the order they registered
+        struct Entry {
+            uint16_t key;
+            Module *module;
+        };
+        std::vector<Entry> entries;
+};
+
+#endif
@@ -12,6 +12,8 @@
 #include "libs/SlowTicker.h"
 #include "libs/Adc.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/EventProfiler.h"
+#include "libs/LoopLatency.h"
 #include <mri.h>
 #include "checksumm.h"
 #include "ConfigValue.h"
@@ -42,6 +44,8 @@
 #define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
 #define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
 #define acceleration_ticks_per_second_checksum      CHECKSUM("acceleration_ticks_per_second")
+#define event_driven_stepping_checksum              CHECKSUM("event_driven_stepping")
+#define amass_max_level_checksum                    CHECKSUM("amass_max_level")
 #define disable_leds_checksum                       CHECKSUM("leds_disable")
 #define grbl_mode_checksum                          CHECKSUM("grbl_mode")
 #define ok_per_line_checksum                        CHECKSUM("ok_per_line")
@@ -55,6 +59,10 @@ Kernel::Kernel(){
 
     instance= this; // setup the Singleton instance of the kernel
 
+#ifdef EVENT_PROFILE
+    this->event_profiler= new EventProfiler();
+#endif
+
     // serial first at fixed baud rate (DEFAULT_SERIAL_BAUD_RATE) so config can report errors to serial
 	// Set to UART0, this will be changed to use the same UART as MRI if it's enabled
     this->serial = new SerialConsole(USBTX, USBRX, DEFAULT_SERIAL_BAUD_RATE);
@@ -109,6 +117,7 @@ Kernel::Kernel(){
     add_module( this->slow_ticker = new SlowTicker());
 
     this->step_ticker = new StepTicker();
+    this->loop_latency = new LoopLatency();
     this->adc = new(AHB0) Adc();
 
     // TODO : These should go into platform-specific files
@@ -146,6 +155,8 @@ Kernel::Kernel(){
     this->step_ticker->set_reset_delay( microseconds_per_step_pulse );
     this->step_ticker->set_frequency( this->base_stepping_frequency );
     this->step_ticker->set_acceleration_ticks_per_second(acceleration_ticks_per_second); // must be set after set_frequency
+    this->step_ticker->set_event_driven( this->config->value(event_driven_stepping_checksum)->by_default(false)->as_bool() );
+    this->step_ticker->set_amass_max_level( this->config->value(amass_max_level_checksum)->by_default(0)->as_int() ); // must be set after the frequency and reset delay
 
     // Core modules
     this->add_module( this->gcode_dispatch = new GcodeDispatch() );
@@ -229,22 +240,50 @@ void Kernel::add_module(Module* module){
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
+#ifdef EVENT_PROFILE
+    this->event_profiler->add(id_event, mod);
+#endif
+    if(id_event == ON_GCODE_RECEIVED) {
+        // every line
+        this->gcode_handlers.add_all(mod);
+        return;
+    }
     this->hooks[id_event].push_back(mod);
 }
 
+// Adds a module to the ones a G or M code is sent to on ON_GCODE_RECEIVED
+void Kernel::register_for_gcode(char letter, int code, Module *mod){
+#ifdef EVENT_PROFILE
+    this->event_profiler->add(ON_GCODE_RECEIVED, mod);
+#endif
+    this->gcode_handlers.add(letter, code, mod);
+}
+
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
     if(id_event == ON_HALT) {
         this->halted= (argument == nullptr);
     }
+    if(id_event == ON_GCODE_RECEIVED) {
+        Gcode *gcode= static_cast<Gcode *>(argument);
+        this->robot->queue_pending_segments_before(gcode);
+        this->gcode_handlers.dispatch(gcode);
+    }
     for (auto m : hooks[id_event]) {
+#ifdef EVENT_PROFILE
+        uint32_t start= EventProfiler::cycles();
+        (m->*kernel_callback_functions[id_event])(argument);
+        this->event_profiler->record(id_event, m, EventProfiler::cycles() - start);
+#else
         (m->*kernel_callback_functions[id_event])(argument);
+#endif
     }
 }
 
 // These are used by tests to test for various things. basically mocks
 bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) return this->gcode_handlers.contains(mod);
     for (auto m : hooks[id_event]) {
         if(m == mod) return true;
     }
@@ -253,6 +292,10 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) {
+        this->gcode_handlers.remove(mod);
+        return;
+    }
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
         if(*i == mod) {
             hooks[id_event].erase(i);
@@ -11,6 +11,7 @@
 #define THEKERNEL Kernel::instance
 
 #include "Module.h"
+#include "GcodeHandlers.h"
 #include <array>
 #include <vector>
 #include <string>
@@ -31,6 +32,8 @@ class Adc;
 class PublicData;
 class SimpleShell;
 class Configurator;
+class EventProfiler;
+class LoopLatency;
 
 class Kernel {
     public:
@@ -40,6 +43,7 @@ class Kernel {
 
         void add_module(Module* module);
         void register_for_event(_EVENT_ENUM id_event, Module *module);
+        void register_for_gcode(char letter, int code, Module *module);
         void call_event(_EVENT_ENUM id_event, void * argument= nullptr);
 
         bool kernel_has_event(_EVENT_ENUM id_event, Module *module);
@@ -71,13 +75,19 @@ class Kernel {
         SlowTicker*       slow_ticker;
         StepTicker*       step_ticker;
         Adc*              adc;
+        LoopLatency*      loop_latency;
         std::string       current_path;
         uint32_t          base_stepping_frequency;
         uint32_t          acceleration_ticks_per_second;
+#ifdef EVENT_PROFILE
+        EventProfiler*    event_profiler;
+#endif
 
     private:
         // When a module asks to be called for a specific event ( a hook ), this is where that request is remembered
         std::array<std::vector<Module*>, NUMBER_OF_DEFINED_EVENTS> hooks;
+        // ON_GCODE_RECEIVED goes to the modules that handle the G or M of the line instead of to hooks
+        GcodeHandlers gcode_handlers;
         struct {
             bool use_leds:1;
             bool halted:1;
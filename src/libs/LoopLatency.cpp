@@ -0,0 +1,86 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LoopLatency.h"
+#include "Kernel.h"
+#include "StreamOutput.h"
+#include "us_ticker_api.h"
+
+#include <string.h>
+
+LoopLatency::LoopLatency()
+{
+    gcode_letter= 0;
+    gcode_code= 0;
+    reset();
+}
+
+// Called each time round the main loop
+void LoopLatency::loop_done()
+{
+    uint32_t now= us_ticker_read();
+    uint32_t us= now - last_us;
+    last_us= now;
+
+    int bucket= us < 2 ? 0 : 31 - __builtin_clz(us);
+    if(bucket >= number_of_buckets) bucket= number_of_buckets - 1;
+    histogram[bucket]++;
+    loops++;
+    if(us > longest_loop_us) longest_loop_us= us;
+}
+
+// keep the wait if it is one of the longest, tagged with the gcode being handled
+void LoopLatency::add_wait(const char *what, void *caller, uint32_t us)
+{
+    int i= number_of_waits - 1;
+    if(us <= waits[i].us) return;
+
+    for (; i > 0 && us > waits[i - 1].us; i--) {
+        waits[i]= waits[i - 1];
+    }
+    waits[i]= {what, caller, us, gcode_code, gcode_letter};
+}
+
+// The caller is the address the function that waited returns to, arm-none-eabi-addr2line -fCe main.elf gives its name
+void LoopLatency::print(StreamOutput *stream) const
+{
+    stream->printf("main loop: %lu loops, longest %lu us\n", loops, longest_loop_us);
+    for (int i = 0; i < number_of_buckets; i++) {
+        if(histogram[i] == 0) continue;
+        if(i == number_of_buckets - 1) stream->printf("  >= %lu us: %lu\n", 1UL << i, histogram[i]);
+        else stream->printf("  < %lu us: %lu\n", 2UL << i, histogram[i]);
+    }
+
+    stream->printf("longest waits:\n");
+    for (int i = 0; i < number_of_waits && waits[i].us > 0; i++) {
+        const wait_t& w= waits[i];
+        if(w.letter != 0) {
+            stream->printf("  %lu us %s in %c%u from %p\n", w.us, w.what, w.letter, w.code, w.caller);
+        } else {
+            stream->printf("  %lu us %s from %p\n", w.us, w.what, w.caller);
+        }
+    }
+}
+
+void LoopLatency::reset()
+{
+    memset(histogram, 0, sizeof(histogram));
+    memset(waits, 0, sizeof(waits));
+    loops= 0;
+    longest_loop_us= 0;
+    last_us= us_ticker_read();
+}
+
+BlockingWait::BlockingWait(const char *what, void *caller) : what(what), caller(caller)
+{
+    start_us= us_ticker_read();
+}
+
+BlockingWait::~BlockingWait()
+{
+    THEKERNEL->loop_latency->add_wait(what, caller, us_ticker_read() - start_us);
+}
@@ -0,0 +1,65 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOOPLATENCY_H
+#define LOOPLATENCY_H
+
+#include <stdint.h>
+
+class StreamOutput;
+
+// How long the main loop takes to go round, which is how long a console line or a query can wait to be seen, and the
+// longest waits that held it up. A module waiting for something calls ON_IDLE until it is done, so the main loop and the
+// console lines it reads stop for as long as that takes
+class LoopLatency {
+    public:
+        LoopLatency();
+
+        void loop_done();
+        void add_wait(const char *what, void *caller, uint32_t us);
+        void set_gcode(char letter, uint16_t code) { gcode_letter= letter; gcode_code= code; }
+        char get_gcode_letter() const { return gcode_letter; }
+        uint16_t get_gcode_code() const { return gcode_code; }
+        void print(StreamOutput *stream) const;
+        void reset();
+
+    private:
+        // a loop of less than 2us goes in the first, then one for each power of 2 up to the last which has the rest
+        static const int number_of_buckets= 24;
+        static const int number_of_waits= 8;
+
+        struct wait_t {
+            const char *what;
+            void *caller;       // the return address of the function that waited
+            uint32_t us;
+            uint16_t code;      // the gcode being handled at the time, letter 0 when there was none
+            char letter;
+        };
+
+        uint32_t histogram[number_of_buckets];
+        uint32_t loops;
+        uint32_t longest_loop_us;
+        uint32_t last_us;
+        wait_t waits[number_of_waits]; // the longest first
+        uint16_t gcode_code;
+        char gcode_letter;
+};
+
+// Adds the time from where it is declared to the end of its scope to the longest waits, what is shown as the cause and
+// caller is usually __builtin_return_address(0)
+class BlockingWait {
+    public:
+        BlockingWait(const char *what, void *caller);
+        ~BlockingWait();
+
+    private:
+        const char *what;
+        void *caller;
+        uint32_t start_us;
+};
+
+#endif
@@ -36,3 +36,8 @@ void Module::register_for_event(_EVENT_ENUM event_id){
     // You add things to Smoothie by making a new class that inherits the Module class. See http://smoothieware.org/moduleexample for a crude introduction
     THEKERNEL->register_for_event(event_id, this);
 }
+
+void Module::register_for_gcode(char letter, int code){
+    // on_gcode_received() is only called for the lines with this G or M, which saves calling every module for every line
+    THEKERNEL->register_for_gcode(letter, code, this);
+}
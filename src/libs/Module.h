@@ -42,6 +42,8 @@ public:
     virtual void on_module_loaded() {};
 
     void register_for_event(_EVENT_ENUM event_id);
+    // instead of ON_GCODE_RECEIVED, only get the lines with this G or M, or with any G or M when code is -1
+    void register_for_gcode(char letter, int code= -1);
 
     // event callbacks, not every module will implement all of these
     // there should be one for each _EVENT_ENUM
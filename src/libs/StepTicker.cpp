@@ -14,6 +14,7 @@
 #include "StepperMotor.h"
 #include "StreamOutputPool.h"
 #include "system_LPC17xx.h" // mbed.h lib
+#include "us_ticker_api.h"
 #include <math.h>
 #include <mri.h>
 
@@ -26,6 +27,11 @@ extern GPIO stepticker_debug_pin;
 // StepTicker handles the base frequency ticking for the Stepper Motors / Actuators
 // It has a list of those, and calls their tick() functions at regular intervals
 // They then do Bresenham stuff themselves
+// When event driven the timer is not reset on each tick, instead the match register is moved to the next tick on which
+// any motor is due to step, so the ticks where nothing would step never interrupt, the skipped ticks are passed to tick()
+// Adaptive multi-axis step smoothing (AMASS) divides the base tick into 2^level ticks for slow blocks, so the steps are
+// placed more finely than the base frequency, the motors still count in base ticks and are moved on by a part of one each tick
+// Each of the interrupts is timed with the DWT cycle counter, see count_isr(), "get isr" shows the load they put on the CPU
 
 StepTicker* StepTicker::global_step_ticker;
 
@@ -53,7 +59,22 @@ StepTicker::StepTicker(){
     LPC_RIT->RICTRL &= ~(8L); // disable
     //NVIC_SetVector(RIT_IRQn, (uint32_t)&_ritisr);
 
+    // start the cycle counter the interrupts are timed with
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    this->isr_cycles= 0;
+    this->pendsv_pended= 0;
+    reset_isr_stats();
+
     // Default start values
+    this->event_driven= false;
+    this->amass_level= 0;
+    this->amass_max_level= 0;
+    this->fx_tick_remainder= 0;
+    this->interrupt_cnt= 0;
+    this->finest_tick_cnt= 0;
+    this->last_match= 0;
+    this->scheduled_ticks= 1;
     this->a_move_finished = false;
     this->do_move_finished = 0;
     this->unstep.reset();
@@ -79,13 +100,118 @@ void StepTicker::start() {
 void StepTicker::set_frequency( float frequency ){
     this->frequency = frequency;
     this->period = floorf((SystemCoreClock/4.0F)/frequency);  // SystemCoreClock/4 = Timer increments in a second
-    LPC_TIM0->MR0 = this->period;
+    set_tick_period();
+}
+
+// Divide the base period by 2^amass_level and set the timer to it
+void StepTicker::set_tick_period()
+{
+    this->tick_period = this->period >> this->amass_level;
+    // the period may not divide exactly so work out the part of a base tick each tick is, this is exact when not divided
+    this->fx_tick_increment = (StepperMotor::fx_increment * this->tick_period + this->period / 2) / this->period;
+    if(event_driven && active_motor.any()) return; // the match is moved on from the last one by the interrupt
+
+    // when reset on match the timer counts MR0 and then 0, so it takes MR0+1 counts
+    LPC_TIM0->MR0 = event_driven ? this->tick_period : this->tick_period - 1;
     if( LPC_TIM0->TC > LPC_TIM0->MR0 ){
         LPC_TIM0->TCR = 3;  // Reset
         LPC_TIM0->TCR = 1;  // Reset
     }
 }
 
+// Select event driven stepping, where the timer only fires on ticks where a motor steps, must be set before any motor moves
+void StepTicker::set_event_driven(bool flag)
+{
+    this->event_driven= flag;
+    LPC_TIM0->MCR = flag ? 1 : 3;   // event driven lets the timer run free and moves the match, otherwise reset on every match
+    this->scheduled_ticks= 1;
+    set_frequency(this->frequency);
+}
+
+// Set the highest step smoothing level, must be set after the frequency and reset delay
+// the divided tick has to be longer than the step pulse, or the unstep would not happen before the next step
+void StepTicker::set_amass_max_level(uint8_t level)
+{
+    if(level > StepperMotor::fx_shift) level= StepperMotor::fx_shift;
+    while(level > 0 && (this->period >> level) <= LPC_TIM1->MR0) level--;
+    this->amass_max_level= level;
+    if(this->amass_level > level) set_amass_level(level);
+}
+
+// Divide the base tick into 2^level ticks, called at the start of each block, which can be in an interrupt
+void StepTicker::set_amass_level(uint8_t level)
+{
+    if(level > this->amass_max_level) level= this->amass_max_level;
+    if(level == this->amass_level) return;
+
+    uint32_t primask= __get_PRIMASK();
+    __disable_irq();
+    bool running= event_driven && active_motor.any();
+    if(running) {
+        // the ticks already scheduled from last_match are counted again in the new ones, rounded up when they get longer
+        if(level > this->amass_level) {
+            this->scheduled_ticks <<= (level - this->amass_level);
+        } else {
+            uint32_t n= this->amass_level - level;
+            this->scheduled_ticks= (this->scheduled_ticks + (1 << n) - 1) >> n;
+        }
+    }
+    this->amass_level= level;
+    set_tick_period();
+    if(running) {
+        LPC_TIM0->MR0= this->last_match + this->scheduled_ticks * this->tick_period;
+        if((int32_t)(LPC_TIM0->TC - LPC_TIM0->MR0) >= 0) {
+            NVIC_SetPendingIRQ(TIMER0_IRQn);
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+// The number of TIMER0 interrupts and how many there would have been if every tick had been at amass_max_level
+void StepTicker::get_amass_stats(uint64_t& interrupts, uint64_t& finest_ticks) const
+{
+    __disable_irq();
+    interrupts= this->interrupt_cnt;
+    finest_ticks= this->finest_tick_cnt;
+    __enable_irq();
+}
+
+// Copy of the interrupt stats and the microseconds since they were reset
+void StepTicker::get_isr_stats(isr_stats_t stats[NUMBER_OF_ISRS], uint32_t& elapsed_us) const
+{
+    __disable_irq();
+    for (int i = 0; i < NUMBER_OF_ISRS; i++) stats[i]= this->isr_stats[i];
+    elapsed_us= us_ticker_read() - this->isr_stats_start_us;
+    __enable_irq();
+}
+
+void StepTicker::reset_isr_stats()
+{
+    __disable_irq();
+    for (int i = 0; i < NUMBER_OF_ISRS; i++) {
+        this->isr_stats[i]= {0, 0, UINT32_MAX, 0, 0};
+    }
+    this->isr_stats_start_us= us_ticker_read();
+    __enable_irq();
+}
+
+// Called by each interrupt as it returns, start is the cycle count and nested the isr_cycles when it started. The cycles
+// of the interrupts that pre-empted it are taken off, so the cycles of all of them add up to the time spent in them
+void StepTicker::count_isr(ISR_ENUM isr, uint32_t start, uint32_t nested, uint32_t latency)
+{
+    __disable_irq();
+    uint32_t cycles= (DWT->CYCCNT - start) - (this->isr_cycles - nested);
+    this->isr_cycles += cycles;
+    __enable_irq();
+
+    isr_stats_t& s= this->isr_stats[isr];
+    s.count++;
+    s.cycles += cycles;
+    if(cycles > s.max_cycles) s.max_cycles= cycles;
+    if(latency < s.min_latency) s.min_latency= latency;
+    if(latency > s.max_latency) s.max_latency= latency;
+}
+
 // Set the reset delay
 void StepTicker::set_reset_delay( float microseconds ){
     uint32_t delay = floorf((SystemCoreClock/4.0F)*(microseconds/1000000.0F));  // SystemCoreClock/4 = Timer increments in a second
@@ -142,23 +268,43 @@ inline void StepTicker::unstep_tick(){
     this->unstep.reset();
 }
 
+// The timers count at SystemCoreClock/4 and the RIT at SystemCoreClock, the timers that are reset on a match hold the match
+// value for one count before going back to 0, so how long ago the match was is worked out from the count on entry
+
 extern "C" void TIMER1_IRQHandler (void){
+    uint32_t start= DWT->CYCCNT;
+    uint32_t nested= StepTicker::global_step_ticker->get_isr_cycles();
+    uint32_t latency= (LPC_TIM1->TC - LPC_TIM1->MR0) << 2; // the timer is not reset on the match
     LPC_TIM1->IR |= 1 << 0;
     StepTicker::global_step_ticker->unstep_tick();
+    StepTicker::global_step_ticker->count_isr(StepTicker::TIMER1_ISR, start, nested, latency);
 }
 
 // The actual interrupt handler where we do all the work
 extern "C" void TIMER0_IRQHandler (void){
+    uint32_t start= DWT->CYCCNT;
+    uint32_t nested= StepTicker::global_step_ticker->get_isr_cycles();
+    uint32_t tc= LPC_TIM0->TC, mr= LPC_TIM0->MR0;
+    uint32_t latency= (StepTicker::global_step_ticker->is_event_driven() ? tc - mr : tc == mr ? 0 : tc + 1) << 2;
     StepTicker::global_step_ticker->TIMER0_IRQHandler();
+    StepTicker::global_step_ticker->count_isr(StepTicker::TIMER0_ISR, start, nested, latency);
 }
 
 extern "C" void RIT_IRQHandler (void){
+    uint32_t start= DWT->CYCCNT;
+    uint32_t nested= StepTicker::global_step_ticker->get_isr_cycles();
+    uint32_t rc= LPC_RIT->RICOUNTER;
+    uint32_t latency= rc == LPC_RIT->RICOMPVAL ? 0 : rc + 1;
     LPC_RIT->RICTRL |= 1L;
     StepTicker::global_step_ticker->acceleration_tick();
+    StepTicker::global_step_ticker->count_isr(StepTicker::RIT_ISR, start, nested, latency);
 }
 
 extern "C" void PendSV_Handler(void) {
+    uint32_t start= DWT->CYCCNT;
+    uint32_t nested= StepTicker::global_step_ticker->get_isr_cycles();
     StepTicker::global_step_ticker->PendSV_IRQHandler();
+    StepTicker::global_step_ticker->count_isr(StepTicker::PENDSV_ISR, start, nested, start - StepTicker::global_step_ticker->get_pendsv_pended());
 }
 
 // slightly lower priority than TIMER0, the whole end of block/start of block is done here allowing the timer to continue ticking
@@ -189,12 +335,22 @@ void  StepTicker::acceleration_tick() {
 void StepTicker::TIMER0_IRQHandler (void){
     // Reset interrupt register
     LPC_TIM0->IR |= 1 << 0;
-    tick_cnt++; // count number of ticks
+
+    // when event driven the ticks between the last interrupt and this one were skipped as no motor was due to step in them
+    uint32_t ticks= event_driven ? scheduled_ticks : 1;
+    this->interrupt_cnt++;
+    this->finest_tick_cnt += ticks << (this->amass_max_level - this->amass_level);
+
+    // the motors count in base ticks, so move them on by the part of a base tick these ticks make
+    uint32_t fx_ticks= ticks * this->fx_tick_increment;
+    this->fx_tick_remainder += fx_ticks;
+    tick_cnt += this->fx_tick_remainder >> StepperMotor::fx_shift; // count number of base ticks
+    this->fx_tick_remainder &= StepperMotor::fx_increment - 1;
 
     // Step pins NOTE takes 1.2us when nothing to step, 1.8-2us for one motor stepped and 2.6us when two motors stepped, 3.167us when three motors stepped
     for (uint32_t motor = 0; motor < num_motors; motor++){
         // send tick to all active motors
-        if(this->active_motor[motor] && this->motor[motor]->tick()){
+        if(this->active_motor[motor] && this->motor[motor]->tick(fx_ticks)){
             // we stepped so schedule an unstep
             this->unstep[motor]= 1;
         }
@@ -222,8 +378,58 @@ void StepTicker::TIMER0_IRQHandler (void){
     if(this->do_move_finished.load() > 0){
         // we delegate the slow stuff to the pendsv handler which will run as soon as this interrupt exits
         //NVIC_SetPendingIRQ(PendSV_IRQn); this doesn't work
+        if(!(SCB->ICSR & 0x10000000)) this->pendsv_pended= DWT->CYCCNT; // it is late from when it was first pended
         SCB->ICSR = 0x10000000; // SCB_ICSR_PENDSVSET_Msk;
     }
+
+    if(event_driven) {
+        // move the match to the next tick a motor is due to step on
+        this->last_match= LPC_TIM0->MR0;
+        this->scheduled_ticks= next_step_due();
+        LPC_TIM0->MR0= this->last_match + this->scheduled_ticks * this->tick_period;
+        if((int32_t)(LPC_TIM0->TC - LPC_TIM0->MR0) >= 0) {
+            // we are already past it, so the timer will not match, fire again as soon as we exit
+            NVIC_SetPendingIRQ(TIMER0_IRQn);
+        }
+    }
+}
+
+// returns the number of ticks from the last one handled until the first tick on which an active motor will step
+uint32_t StepTicker::next_step_due() const
+{
+    // keep the match within half the timer range so it can always be compared with the current count
+    uint32_t due= 0x7FFFFFFFUL / this->tick_period;
+    for (uint32_t m = 0; m < num_motors; m++){
+        if(!this->active_motor[m]) continue;
+        const StepperMotor *sm= this->motor[m];
+        if(sm->fx_counter >= sm->fx_ticks_per_step) return 1;
+        uint32_t t= (sm->fx_ticks_per_step - sm->fx_counter + this->fx_tick_increment - 1) / this->fx_tick_increment;
+        if(t < due) due= t;
+    }
+    return due;
+}
+
+// Called when a motor step rate changes or a motor starts, when event driven this may bring the next step forward
+// the next interrupt is only ever moved earlier, if it is now too early it will find nothing to step and move it on
+// it is called from interrupts as well as the main loop, so it leaves them disabled if they were
+void StepTicker::reschedule()
+{
+    if(!event_driven || active_motor.none()) return;
+
+    uint32_t primask= __get_PRIMASK();
+    __disable_irq();
+    // the motors have been ticked up to last_match, and a tick that has already passed can not be scheduled
+    uint32_t elapsed= (LPC_TIM0->TC - this->last_match) / this->tick_period;
+    uint32_t due= next_step_due();
+    if(due <= elapsed) due= elapsed + 1;
+    if(due < this->scheduled_ticks) {
+        this->scheduled_ticks= due;
+        LPC_TIM0->MR0= this->last_match + due * this->tick_period;
+        if((int32_t)(LPC_TIM0->TC - LPC_TIM0->MR0) >= 0) {
+            NVIC_SetPendingIRQ(TIMER0_IRQn);
+        }
+    }
+    __set_PRIMASK(primask);
 }
 
 // returns index of the stepper motor in the array and bitset
@@ -239,6 +445,14 @@ void StepTicker::add_motor_to_active_list(StepperMotor* motor)
 {
     bool enabled= active_motor.any(); // see if interrupt was previously enabled
     active_motor[motor->index]= 1;
+    if(event_driven) {
+        if(!enabled) {
+            // the timer is stopped, carry on with the tick it stopped in like the fixed ticker does
+            this->last_match= LPC_TIM0->TC - (LPC_TIM0->TC - this->last_match) % this->tick_period;
+            this->scheduled_ticks= 0xFFFFFFFFUL;
+        }
+        reschedule();
+    }
     if(!enabled) {
         LPC_TIM0->TCR = 1;               // Enable interrupt
     }
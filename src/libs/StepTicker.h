@@ -31,6 +31,14 @@ class StepTicker{
         void add_motor_to_active_list(StepperMotor* motor);
         void remove_motor_from_active_list(StepperMotor* motor);
         void set_acceleration_ticks_per_second(uint32_t acceleration_ticks_per_second);
+        void set_event_driven(bool flag);
+        bool is_event_driven() const { return event_driven; }
+        void set_amass_max_level(uint8_t level);
+        uint8_t get_amass_max_level() const { return amass_max_level; }
+        void set_amass_level(uint8_t level);
+        uint8_t get_amass_level() const { return amass_level; }
+        void get_amass_stats(uint64_t& interrupts, uint64_t& finest_ticks) const;
+        void reschedule();
         float get_frequency() const { return frequency; }
         void unstep_tick();
         uint32_t get_tick_cnt() const { return tick_cnt; }
@@ -46,12 +54,41 @@ class StepTicker{
 
         void start();
 
+        // the interrupts the stepping is done in, each one keeps how often it ran, for how long and how late it started
+        enum ISR_ENUM { TIMER0_ISR, TIMER1_ISR, PENDSV_ISR, RIT_ISR, NUMBER_OF_ISRS };
+        struct isr_stats_t {
+            uint32_t count;
+            uint32_t max_cycles;
+            uint32_t min_latency;   // cycles from when it was due to when it started
+            uint32_t max_latency;
+            uint64_t cycles;        // not counting the interrupts that pre-empted it
+        };
+        void get_isr_stats(isr_stats_t stats[NUMBER_OF_ISRS], uint32_t& elapsed_us) const;
+        void reset_isr_stats();
+        void count_isr(ISR_ENUM isr, uint32_t start, uint32_t nested, uint32_t latency);
+        uint32_t get_isr_cycles() const { return isr_cycles; }
+        uint32_t get_pendsv_pended() const { return pendsv_pended; }
+
         friend class StepperMotor;
 
     private:
+        uint32_t next_step_due() const;
+        void set_tick_period();
+
         float frequency;
         uint32_t period;
+        uint32_t tick_period;       // timer counts per tick, the period divided by 2^amass_level
+        uint32_t fx_tick_increment; // how far one tick moves the motor fx counters, which count in base ticks
+        uint32_t fx_tick_remainder; // the part of a base tick counted so far when the tick is divided
+        uint32_t last_match;      // timer count of the last tick handled when event driven
+        uint32_t scheduled_ticks; // number of ticks from last_match to the next interrupt when event driven
         volatile uint32_t tick_cnt;
+        uint64_t interrupt_cnt;     // TIMER0 interrupts, and the ticks there would have been at amass_max_level
+        uint64_t finest_tick_cnt;
+        isr_stats_t isr_stats[NUMBER_OF_ISRS];
+        uint32_t isr_stats_start_us;
+        volatile uint32_t isr_cycles; // the cycles of all the counted interrupts
+        uint32_t pendsv_pended;       // cycle count when PendSV was last pended
         std::vector<std::function<void(void)>> acceleration_tick_handlers;
         std::vector<StepperMotor*> motor;
         std::bitset<32> active_motor; // limit to 32 motors
@@ -59,7 +96,10 @@ class StepTicker{
         std::atomic_uchar do_move_finished;
 
         uint8_t num_motors;
+        uint8_t amass_level;
+        uint8_t amass_max_level;
         volatile bool a_move_finished;
+        bool event_driven;
 };
 
 
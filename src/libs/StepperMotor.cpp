@@ -50,11 +50,14 @@ void StepperMotor::init()
     steps_per_mm         = 1.0F;
     max_rate             = 50.0F;
     minimum_step_rate    = default_minimum_actuator_rate;
+    acceleration         = 0.0F;
 
     last_milestone_steps = 0;
     last_milestone_mm    = 0.0F;
     current_position_steps= 0;
     signal_step= 0;
+    step_hook= nullptr;
+    hook_step= 0;
 }
 
 
@@ -84,6 +87,11 @@ void StepperMotor::step()
             THEKERNEL->step_ticker->synchronize_acceleration(true);
             this->signal_step= 0;
         }
+
+        // the hook can be set a step or two late when the move starts before it is, so it is called as soon as it is due
+        if(this->hook_step != 0 && this->stepped >= this->hook_step) {
+            this->hook_step= this->step_hook->call(this->stepped);
+        }
     }
 
     // Is this move finished ?
@@ -141,6 +149,7 @@ StepperMotor* StepperMotor::move( bool direction, unsigned int steps, float init
 
     // Zero our tool counters
     this->stepped = 0;
+    this->hook_step = 0;
     this->fx_ticks_per_step = 0xFFFFF000UL; // some big number so we don't start stepping before it is set again
     if(this->last_step_tick_valid) {
         // we set this based on when the last step was, thus compensating for missed ticks
@@ -186,11 +195,30 @@ StepperMotor* StepperMotor::set_speed( float speed )
     // How many steps we must output per second
     this->steps_per_second = speed;
 
-    // set the new speed, NOTE this can be pre-empted by stepticker so the following write needs to be atomic
-    this->fx_ticks_per_step= floor(fx_increment * THEKERNEL->step_ticker->get_frequency() / speed);
+    set_fx_ticks_per_step(fx_ticks_for_speed(speed));
     return this;
 }
 
+// The fixed point ticks per step set_speed() would set for this speed, used by Stepper to prepare the speeds ahead of time
+// Note steps_per_second is only updated by set_speed()
+uint32_t StepperMotor::fx_ticks_for_speed( float speed ) const
+{
+    if(speed < minimum_step_rate) {
+        speed= minimum_step_rate;
+    }
+    return floor(fx_increment * THEKERNEL->step_ticker->get_frequency() / speed);
+}
+
+// Set the step rate from a value calculated by fx_ticks_for_speed(), there is no floating point math here so it can be called from an interrupt
+void StepperMotor::set_fx_ticks_per_step( uint32_t fx_ticks )
+{
+    // set the new speed, NOTE this can be pre-empted by stepticker so the following write needs to be atomic
+    this->fx_ticks_per_step= fx_ticks;
+
+    // if the step ticker is event driven the next step may now be due sooner than it had scheduled
+    THEKERNEL->step_ticker->reschedule();
+}
+
 void StepperMotor::change_steps_per_mm(float new_steps)
 {
     steps_per_mm = new_steps;
@@ -33,6 +33,8 @@ class StepperMotor {
         StepperMotor* move( bool direction, unsigned int steps, float initial_speed= -1.0F);
         void signal_move_finished();
         StepperMotor* set_speed( float speed );
+        uint32_t fx_ticks_for_speed( float speed ) const;
+        void set_fx_ticks_per_step( uint32_t fx_ticks );
         void set_moved_last_block(bool flg) { last_step_tick_valid= flg; }
         void update_exit_tick();
 
@@ -46,6 +48,8 @@ class StepperMotor {
         void set_max_rate(float mr) { max_rate= mr; }
         float get_min_rate(void) const { return minimum_step_rate; }
         void set_min_rate(float mr) { minimum_step_rate= mr; }
+        float get_acceleration(void) const { return acceleration; }
+        void set_acceleration(float a) { acceleration= a; }
 
         int  steps_to_target(float);
         uint32_t get_steps_to_move() const { return steps_to_move; }
@@ -58,6 +62,14 @@ class StepperMotor {
             this->end_hook = hook;
         }
 
+        // call back in the step interrupt once the motor has made the given step of the current move, the callback is given the
+        // steps made and returns the next step to be called on, or 0. Each move starts without one
+        template<typename T> void set_step_hook( T *optr, uint32_t ( T::*fptr )( uint32_t ), uint32_t step ){
+            if(this->step_hook == nullptr) this->step_hook = new Hook();
+            this->step_hook->attach(optr, fptr);
+            this->hook_step = step;
+        }
+
         friend class StepTicker;
         friend class Stepper;
         friend class Planner;
@@ -68,6 +80,7 @@ class StepperMotor {
 
         int index;
         Hook* end_hook;
+        Hook* step_hook;
 
         Pin step_pin;
         Pin dir_pin;
@@ -77,6 +90,7 @@ class StepperMotor {
         float steps_per_mm;
         float max_rate; // this is not really rate it is in mm/sec, misnamed used in Robot and Extruder
         float minimum_step_rate; // this is the minimum step_rate in steps/sec for this motor for this block
+        float acceleration; // in mm/sec², the planner keeps the blocks this motor moves in under it, 0 for no limit of its own
         static float default_minimum_actuator_rate;
 
         volatile int32_t current_position_steps;
@@ -87,6 +101,7 @@ class StepperMotor {
         uint32_t stepped;
         uint32_t last_step_tick;
         uint32_t signal_step;
+        volatile uint32_t hook_step;
 
         // set to 32 bit fixed point, 18:14 bits fractional
         static const uint32_t fx_shift= 14;
@@ -103,9 +118,11 @@ class StepperMotor {
         };
 
         // Called a great many times per second, to step if we have to now
-        inline bool tick() {
-            // increase the ( 32 fixed point 18:14 ) counter by one tick 11t
-            fx_counter += fx_increment;
+        // fx_ticks is the base ticks since the last call in the same fixed point as the counter, it is more than one when the
+        // StepTicker is event driven and skipped the ticks where nothing was due to step, and less when step smoothing divides them
+        inline bool tick(uint32_t fx_ticks) {
+            // increase the ( 32 fixed point 18:14 ) counter by the ticks 11t
+            fx_counter += fx_ticks;
 
             // if we are to step now
             if (fx_counter >= fx_ticks_per_step){
@@ -24,6 +24,7 @@
 #include "libs/Kernel.h"
 #include "libs/SerialMessage.h"
 #include "StreamOutputPool.h"
+#include "modules/robot/Robot.h"
 
 // extern void setled(int, bool);
 #define setled(a, b) do {} while (0)
@@ -339,6 +340,9 @@ void USBSerial::on_main_loop(void *argument)
     // if we are in feed hold we do not process anything
     if(THEKERNEL->get_feed_hold()) return;
 
+    // nor until the last move from here has been cut into segments
+    if(THEKERNEL->robot->has_pending_segments(this)) return;
+
     if (nl_in_rx)
     {
         string received;
@@ -35,6 +35,7 @@
 #include "ConfigValue.h"
 #include "StepTicker.h"
 #include "SlowTicker.h"
+#include "LoopLatency.h"
 
 // #include "libs/ChaNFSSD/SDFileSystem.h"
 #include "libs/nuts_bolts.h"
@@ -287,6 +288,8 @@ int main()
     init();
 
     uint16_t cnt= 0;
+    // the time taken to start up is not a loop
+    THEKERNEL->loop_latency->reset();
     // Main loop
     while(1){
         if(THEKERNEL->is_using_leds()) {
@@ -295,5 +298,6 @@ int main()
         }
         THEKERNEL->call_event(ON_MAIN_LOOP);
         THEKERNEL->call_event(ON_IDLE);
+        THEKERNEL->loop_latency->loop_done();
     }
 }
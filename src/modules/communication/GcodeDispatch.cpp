@@ -25,6 +25,7 @@
 #include "SimpleShell.h"
 #include "utils.h"
 #include "LPC17xx.h"
+#include "LoopLatency.h"
 
 #define return_error_on_unhandled_gcode_checksum    CHECKSUM("return_error_on_unhandled_gcode")
 #define panel_display_message_checksum CHECKSUM("display_message")
@@ -39,6 +40,11 @@ static bool is_allowed_mcode(int m) {
     return false;
 }
 
+// a G7 raster line, which ends with its pixels in base64
+static bool is_raster_line(const string& command) {
+    return command.size() > 2 && command[0] == 'G' && command[1] == '7' && !isdigit(command[2]);
+}
+
 GcodeDispatch::GcodeDispatch()
 {
     uploading = false;
@@ -132,8 +138,8 @@ try_again:
             }
 
             while(possible_command.size() > 0) {
-                // assumes G or M are always the first on the line
-                size_t nextcmd = possible_command.find_first_of("GM", 2);
+                // assumes G or M are always the first on the line, a G7 is always the last as its pixels can have any letter in them
+                size_t nextcmd = is_raster_line(possible_command) ? string::npos : possible_command.find_first_of("GM", 2);
                 string single_command;
                 if(nextcmd == string::npos) {
                     single_command = possible_command;
@@ -324,7 +330,17 @@ try_again:
 
                     //printf("dispatch %p: '%s' G%d M%d...", gcode, gcode->command.c_str(), gcode->g, gcode->m);
                     //Dispatch message!
+                    char letter= gcode->has_g ? 'G' : gcode->has_m ? 'M' : 'T';
+                    uint16_t code= gcode->has_g ? gcode->g : gcode->has_m ? gcode->m : 0;
+
+                    // any wait while the modules handle it is put down to this gcode
+                    LoopLatency *ll= THEKERNEL->loop_latency;
+                    char last_letter= ll->get_gcode_letter();
+                    uint16_t last_code= ll->get_gcode_code();
+                    ll->set_gcode(letter, code);
+
                     THEKERNEL->call_event(ON_GCODE_RECEIVED, gcode );
+                    ll->set_gcode(last_letter, last_code);
 
                     if (gcode->is_error) {
                         // report error
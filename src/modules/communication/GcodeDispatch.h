@@ -25,6 +25,7 @@ public:
     virtual void on_console_line_received(void *line);
 
     uint8_t get_modal_command() const { return modal_group_1<4 ? modal_group_1 : 0; }
+
 private:
     int currentline;
     string upload_filename;
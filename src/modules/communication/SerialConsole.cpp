@@ -7,6 +7,7 @@
 
 #include <string>
 #include <stdarg.h>
+#include <string.h>
 using std::string;
 #include "libs/Module.h"
 #include "libs/Kernel.h"
@@ -16,6 +17,7 @@ using std::string;
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "libs/StreamOutputPool.h"
+#include "Robot.h"
 
 // Serial reading module
 // Treats every received line as a command and passes it ( via event call ) to the command dispatcher.
@@ -23,6 +25,7 @@ using std::string;
 SerialConsole::SerialConsole( PinName rx_pin, PinName tx_pin, int baud_rate ){
     this->serial = new mbed::Serial( rx_pin, tx_pin );
     this->serial->baud(baud_rate);
+    this->nl_in_rx= 0;
 }
 
 // Called when the module has just been loaded
@@ -55,6 +58,7 @@ void SerialConsole::on_serial_char_received(){
         // convert CR to NL (for host OSs that don't send NL)
         if( received == '\r' ){ received = '\n'; }
         this->buffer.push_back(received);
+        if(received == '\n') nl_in_rx++;
     }
 }
 
@@ -72,23 +76,35 @@ void SerialConsole::on_idle(void * argument)
 
 // Actual event calling must happen in the main loop because if it happens in the interrupt we will loose data
 void SerialConsole::on_main_loop(void * argument){
-    if( this->has_char('\n') ){
-        string received;
-        received.reserve(20);
-        while(1){
-           char c;
-           this->buffer.pop_front(c);
-           if( c == '\n' ){
-                struct SerialMessage message;
-                message.message = received;
-                message.stream = this;
-                THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
-                return;
-            }else{
-                received += c;
-            }
+    // the next line waits until the last move from here has been cut into segments, the main loop keeps running meanwhile
+    if(THEKERNEL->robot->has_pending_segments(this)) return;
+
+    // the interrupt counts the lines as they come in, so the buffer is only looked at when there is a whole one
+    if(nl_in_rx.load() == 0) return;
+
+    // the line is copied out in one go, from the tail up to the end of the buffer and from the start if it wraps
+    const int length= sizeof(this->buffer.buffer);
+    int tail= this->buffer.tail, head= this->buffer.head;
+    const char *start= this->buffer.buffer + tail;
+    const char *nl= (const char *)memchr(start, '\n', (head >= tail ? head : length) - tail);
+
+    struct SerialMessage message;
+    message.stream = this;
+    if(nl != NULL) {
+        message.message.assign(start, nl - start);
+    } else {
+        if(head < tail) nl= (const char *)memchr(this->buffer.buffer, '\n', head);
+        if(nl == NULL) {
+            // the newline was overwritten when the buffer overflowed
+            nl_in_rx= 0;
+            return;
         }
+        message.message.assign(start, length - tail).append(this->buffer.buffer, nl - this->buffer.buffer);
     }
+
+    this->buffer.tail= (nl - this->buffer.buffer + 1) & (length - 1);
+    nl_in_rx--;
+    THEKERNEL->call_event(ON_CONSOLE_LINE_RECEIVED, &message );
 }
 
 
@@ -13,6 +13,7 @@
 #include "libs/Kernel.h"
 #include <vector>
 #include <string>
+#include <atomic>
 using std::string;
 #include "libs/RingBuffer.h"
 #include "libs/StreamOutput.h"
@@ -37,6 +38,7 @@ class SerialConsole : public Module, public StreamOutput {
         //string receive_buffer;                 // Received chars are stored here until a newline character is received
         //vector<std::string> received_lines;    // Received lines are stored here until they are requested
         RingBuffer<char,256> buffer;             // Receive buffer
+        std::atomic_int nl_in_rx;                // number of complete lines in the buffer
         mbed::Serial* serial;
         struct {
           bool query_flag:1;
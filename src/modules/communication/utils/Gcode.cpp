@@ -12,49 +12,65 @@
 #include <stdlib.h>
 #include <algorithm>
 
+// The text is shared by the copies of a Gcode, such as the ones attached to blocks, so copying one needs no allocation.
+// It is stored after a count of the Gcodes using it. Gcodes are only copied and deleted in the main loop so the count needs no locking
+static char *new_text(const char *str)
+{
+    size_t n= strlen(str) + 1;
+    uint32_t *mem= (uint32_t *)malloc(sizeof(uint32_t) + n);
+    *mem= 1;
+    memcpy(mem + 1, str, n);
+    return (char *)(mem + 1);
+}
+
+static char *share_text(char *text)
+{
+    if(text != nullptr) ++((uint32_t *)text)[-1];
+    return text;
+}
+
+static void release_text(char *text)
+{
+    if(text != nullptr && --((uint32_t *)text)[-1] == 0) free((uint32_t *)text - 1);
+}
+
 // This is a gcode object. It represents a GCode string/command, and caches some important values about that command for the sake of performance.
 // It gets passed around in events, and attached to the queue ( that'll change )
 Gcode::Gcode(const string &command, StreamOutput *stream, bool strip)
 {
-    this->command= strdup(command.c_str());
+    this->command= nullptr;
     this->m= 0;
     this->g= 0;
     this->subcode= 0;
     this->add_nl= false;
     this->is_error= false;
+    this->queued_for= 0;
     this->stream= stream;
     this->millimeters_of_travel = 0.0F;
-    prepare_cached_values(strip);
+    prepare_cached_values(command.c_str(), strip);
     this->stripped= strip;
 }
 
 Gcode::~Gcode()
 {
-    if(command != nullptr) {
-        // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
-        free(command);
-    }
+    release_text(command);
 }
 
 Gcode::Gcode(const Gcode &to_copy)
 {
-    this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
-    this->millimeters_of_travel = to_copy.millimeters_of_travel;
-    this->has_m                 = to_copy.has_m;
-    this->has_g                 = to_copy.has_g;
-    this->m                     = to_copy.m;
-    this->g                     = to_copy.g;
-    this->subcode               = to_copy.subcode;
-    this->add_nl                = to_copy.add_nl;
-    this->is_error              = to_copy.is_error;
-    this->stream                = to_copy.stream;
-    this->txt_after_ok.assign( to_copy.txt_after_ok );
+    this->command               = nullptr;
+    *this = to_copy;
 }
 
 Gcode &Gcode::operator= (const Gcode &to_copy)
 {
     if( this != &to_copy ) {
-        this->command               = strdup(to_copy.command); // TODO we can reference count this so we share copies, may save more ram than the extra count we need to store
+        char *old= this->command;
+        this->command               = share_text(to_copy.command);
+        release_text(old);
+        this->letters               = to_copy.letters;
+        memcpy(this->values, to_copy.values, sizeof(this->values));
+        this->all_args_parsed       = to_copy.all_args_parsed;
         this->millimeters_of_travel = to_copy.millimeters_of_travel;
         this->has_m                 = to_copy.has_m;
         this->has_g                 = to_copy.has_g;
@@ -62,79 +78,100 @@ Gcode &Gcode::operator= (const Gcode &to_copy)
         this->g                     = to_copy.g;
         this->subcode               = to_copy.subcode;
         this->add_nl                = to_copy.add_nl;
+        this->stripped              = to_copy.stripped;
         this->is_error              = to_copy.is_error;
+        this->queued_for            = to_copy.queued_for;
         this->stream                = to_copy.stream;
         this->txt_after_ok.assign( to_copy.txt_after_ok );
     }
     return *this;
 }
 
+// index into values of the given letter, or -1 if it was not parsed
+int Gcode::find_arg( char letter ) const
+{
+    if(letter < 'A' || letter > 'Z') return -1;
+    uint32_t bit= 1 << (letter - 'A');
+    if((letters & bit) == 0) return -1;
+    return __builtin_popcount(letters & (bit - 1));
+}
 
-// Whether or not a Gcode has a letter
-bool Gcode::has_letter( char letter ) const
+// the text following the first occurrence of the letter that has a number, for letters that are not in values
+const char *Gcode::find_value( char letter ) const
 {
-    for (size_t i = 0; i < strlen(this->command); ++i) {
-        if( command[i] == letter ) {
-            return true;
+    if(command == nullptr || (all_args_parsed && letter >= 'A' && letter <= 'Z')) return nullptr;
+    for (const char *cs = command; *cs; cs++) {
+        if( letter == *cs ) {
+            char *cn;
+            strtof(cs+1, &cn);
+            if (cn > cs+1)
+                return cs+1;
         }
     }
-    return false;
+    return nullptr;
+}
+
+// Whether or not a Gcode has a letter
+bool Gcode::has_letter( char letter ) const
+{
+    if(find_arg(letter) >= 0) return true;
+    if(command == nullptr || (all_args_parsed && letter >= 'A' && letter <= 'Z')) return false;
+    return strchr(command, letter) != nullptr;
 }
 
 // Retrieve the value for a given letter
-float Gcode::get_value( char letter, char **ptr ) const
+float Gcode::get_value( char letter ) const
 {
-    const char *cs = command;
-    char *cn = NULL;
-    for (; *cs; cs++) {
-        if( letter == *cs ) {
-            cs++;
-            float r = strtof(cs, &cn);
-            if(ptr != nullptr) *ptr= cn;
-            if (cn > cs)
-                return r;
-        }
-    }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+    int i= find_arg(letter);
+    if(i >= 0) return values[i];
+
+    const char *cs= find_value(letter);
+    return cs != nullptr ? strtof(cs, nullptr) : 0;
 }
 
-int Gcode::get_int( char letter, char **ptr ) const
+// integers are read from the text when it is kept so they do not lose precision in the float
+int Gcode::get_int( char letter ) const
 {
-    const char *cs = command;
-    char *cn = NULL;
-    for (; *cs; cs++) {
-        if( letter == *cs ) {
-            cs++;
-            int r = strtol(cs, &cn, 10);
-            if(ptr != nullptr) *ptr= cn;
-            if (cn > cs)
-                return r;
+    const char *cs= nullptr;
+    if(command != nullptr) {
+        for (cs = command; *cs; cs++) {
+            if(letter == *cs) {
+                char *cn;
+                int r = strtol(cs+1, &cn, 10);
+                if (cn > cs+1)
+                    return r;
+            }
         }
+        if(!all_args_parsed) return 0;
     }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+
+    int i= find_arg(letter);
+    return i >= 0 ? (int)values[i] : 0;
 }
 
-uint32_t Gcode::get_uint( char letter, char **ptr ) const
+uint32_t Gcode::get_uint( char letter ) const
 {
-    const char *cs = command;
-    char *cn = NULL;
-    for (; *cs; cs++) {
-        if( letter == *cs ) {
-            cs++;
-            int r = strtoul(cs, &cn, 10);
-            if(ptr != nullptr) *ptr= cn;
-            if (cn > cs)
-                return r;
+    const char *cs= nullptr;
+    if(command != nullptr) {
+        for (cs = command; *cs; cs++) {
+            if(letter == *cs) {
+                char *cn;
+                uint32_t r = strtoul(cs+1, &cn, 10);
+                if (cn > cs+1)
+                    return r;
+            }
         }
+        if(!all_args_parsed) return 0;
     }
-    if(ptr != nullptr) *ptr= nullptr;
-    return 0;
+
+    int i= find_arg(letter);
+    return i >= 0 ? (uint32_t)values[i] : 0;
 }
 
 int Gcode::get_num_args() const
 {
+    if(all_args_parsed) return __builtin_popcount(letters & ~(1 << ('T' - 'A')));
+
     int count = 0;
     for(size_t i = stripped?0:1; i < strlen(command); i++) {
         if( this->command[i] >= 'A' && this->command[i] <= 'Z' ) {
@@ -148,6 +185,13 @@ int Gcode::get_num_args() const
 std::map<char,float> Gcode::get_args() const
 {
     std::map<char,float> m;
+    if(all_args_parsed) {
+        for(char c = 'A'; c <= 'Z'; c++) {
+            if(c != 'T' && find_arg(c) >= 0) m[c]= get_value(c);
+        }
+        return m;
+    }
+
     for(size_t i = stripped?0:1; i < strlen(command); i++) {
         char c= this->command[i];
         if( c >= 'A' && c <= 'Z' ) {
@@ -161,6 +205,13 @@ std::map<char,float> Gcode::get_args() const
 std::map<char,int> Gcode::get_args_int() const
 {
     std::map<char,int> m;
+    if(all_args_parsed) {
+        for(char c = 'A'; c <= 'Z'; c++) {
+            if(c != 'T' && find_arg(c) >= 0) m[c]= get_int(c);
+        }
+        return m;
+    }
+
     for(size_t i = stripped?0:1; i < strlen(command); i++) {
         char c= this->command[i];
         if( c >= 'A' && c <= 'Z' ) {
@@ -171,50 +222,94 @@ std::map<char,int> Gcode::get_args_int() const
     return m;
 }
 
-// Cache some of this command's properties, so we don't have to parse the string every time we want to look at them
-void Gcode::prepare_cached_values(bool strip)
+// Parse the line once, caching the command and the value of each letter so we don't have to parse the string every time we want to look at them
+void Gcode::prepare_cached_values(const char *line, bool strip)
 {
-    char *p= nullptr;
-    if( this->has_letter('G') ) {
-        this->has_g = true;
-        this->g = this->get_int('G', &p);
+    // the first G or M with a number is the command
+    const char *p= line;
+    this->has_g = false;
+    this->has_m = false;
+    for (const char *cs = line; *cs; cs++) {
+        if(*cs != 'G' && *cs != 'M') continue;
+        char *cn;
+        unsigned int n= strtoul(cs+1, &cn, 10);
+        if(cn == cs+1) continue;
 
-    } else {
-        this->has_g = false;
+        if(*cs == 'G') {
+            this->has_g = true;
+            this->g = n;
+        }else{
+            this->has_m = true;
+            this->m = n;
+        }
+
+        // look for subcode and extract it
+        if(*cn == '.') {
+            this->subcode = strtoul(cn+1, &cn, 10);
+        }
+        p= cn;
+        break;
     }
 
-    if( this->has_letter('M') ) {
-        this->has_m = true;
-        this->m = this->get_int('M', &p);
+    // with strip the text and the letters start after the Gxxx or Mxxx
+    const char *args= strip ? p : line;
 
-    } else {
-        this->has_m = false;
-    }
+    this->letters= 0;
+    this->all_args_parsed= true;
+    uint32_t valued= 0;
+    int nargs= 0;
+    for (const char *cs = args; *cs; cs++) {
+        if(*cs < 'A' || *cs > 'Z') continue;
+        uint32_t bit= 1 << (*cs - 'A');
+        // the D of a G7 raster line is followed by its pixels in base64 to the end of the line, they are not letters
+        bool pixels= has_g && g == 7 && *cs == 'D';
+        char *cn;
+        float v= pixels ? 0 : strtof(cs+1, &cn);
+        bool has_value= !pixels && cn > cs+1;
 
-    if(has_g || has_m) {
-        // look for subcode and extract it
-        if(p != nullptr && *p == '.') {
-            this->subcode = strtoul(p+1, &p, 10);
+        if((letters & bit) == 0) {
+            if(nargs == max_args) {
+                // no room, it will be looked up in the text
+                this->all_args_parsed= false;
+                continue;
+            }
+            // insert it in letter order
+            int i= __builtin_popcount(letters & (bit - 1));
+            memmove(&values[i+1], &values[i], (nargs - i) * sizeof(float));
+            values[i]= has_value ? v : 0;
+            letters |= bit;
+            nargs++;
 
-        }else{
-            this->subcode= 0;
+        }else if(has_value && (valued & bit) == 0) {
+            // like the text scan we use the first occurrence that has a value
+            values[find_arg(*cs)]= v;
         }
+        if(has_value) valued |= bit;
+        if(has_value) cs= cn - 1;
+        if(pixels) break;
     }
 
-    if(!strip) return;
-
-    // remove the Gxxx or Mxxx from string
-    if (p != nullptr) {
-        char *n= strdup(p); // create new string starting at end of the numeric value
-        free(command);
-        command= n;
+    // the values are all we need for moves, which are most of what we get, so only keep the text of the rest
+    if(!strip || !has_g || g > 3 || !all_args_parsed) {
+        this->command= new_text(args);
     }
 }
 
 // strip off X Y Z I J K parameters if G0/1/2/3
 void Gcode::strip_parameters()
 {
-    if(has_g && g < 4){
+    if(has_g && g < 4 && letters != 0) {
+        // remove their values keeping the rest in letter order
+        int n= 0;
+        for(char c = 'A'; c <= 'Z'; c++) {
+            int i= find_arg(c);
+            if(i < 0) continue;
+            if(strchr("XYZIJK", c) == nullptr) values[n++]= values[i];
+        }
+        letters &= ~((1 << ('X' - 'A')) | (1 << ('Y' - 'A')) | (1 << ('Z' - 'A')) | (1 << ('I' - 'A')) | (1 << ('J' - 'A')) | (1 << ('K' - 'A')));
+    }
+
+    if(has_g && g < 4 && command != nullptr){
         // strip the command of the XYZIJK parameters
         string newcmd;
         char *cn= command;
@@ -238,8 +333,8 @@ void Gcode::strip_parameters()
         //newcmd.erase(std::remove_if(newcmd.begin(), newcmd.end(), ::isspace), newcmd.end());
 
         // release the old one
-        free(command);
-        // copy the new shortened one
-        command= strdup(newcmd.c_str());
+        release_text(command);
+        // copy the new shortened one, the old one may still be used by other copies
+        command= new_text(newcmd.c_str());
     }
 }
@@ -23,11 +23,12 @@ class Gcode {
         Gcode& operator= (const Gcode& to_copy);
         ~Gcode();
 
-        const char* get_command() const { return command; }
+        // NOTE the text of G0 to G3 is not kept once it has been parsed, use the values
+        const char* get_command() const { return command != nullptr ? command : ""; }
         bool has_letter ( char letter ) const;
-        float get_value ( char letter, char **ptr= nullptr ) const;
-        int get_int ( char letter, char **ptr= nullptr ) const;
-        uint32_t get_uint ( char letter, char **ptr= nullptr ) const;
+        float get_value ( char letter ) const;
+        int get_int ( char letter ) const;
+        uint32_t get_uint ( char letter ) const;
         int get_num_args() const;
         std::map<char,float> get_args() const;
         std::map<char,int> get_args_int() const;
@@ -46,12 +47,23 @@ class Gcode {
             bool is_error:1;
             uint8_t subcode:3;
         };
+        uint16_t queued_for;    // name checksum of the module instance that attached it to the queue, for codes several handle
+
 
         StreamOutput* stream;
         string txt_after_ok;
 
     private:
-        void prepare_cached_values(bool strip=true);
+        void prepare_cached_values(const char *line, bool strip=true);
+        int find_arg(char letter) const;
+        const char *find_value(char letter) const;
+
+        // the line is parsed once into a value for each letter on it, kept in letter order so a letter's value is found by
+        // counting the letters before it. If there are more letters than fit the rest are looked up in the text
+        static const int max_args= 8;
+        uint32_t letters;           // bit per letter A-Z on the line
+        float values[max_args];
+        bool all_args_parsed;
         char *command;
 };
 #endif
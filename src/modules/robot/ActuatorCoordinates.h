@@ -13,9 +13,18 @@
 #define MAX_ROBOT_ACTUATORS 3
 #endif
 
+#ifndef MAX_ROBOT_EXTRUDERS
+#define MAX_ROBOT_EXTRUDERS 2
+#endif
+
 //The subset in use is determined by the arm solution's get_actuator_count().
 //Keep MAX_ROBOT_ACTUATORS as small as practical it impacts block size and therefore free memory.
 const size_t k_max_actuators = MAX_ROBOT_ACTUATORS;
 typedef struct std::array<float, k_max_actuators> ActuatorCoordinates;
 
+//The planner moves the extruders along with the arm, their motors come after the actuators, see Robot::register_motor().
+//The same goes for MAX_ROBOT_EXTRUDERS, each block has the steps of every motor.
+const size_t k_max_motors = k_max_actuators + MAX_ROBOT_EXTRUDERS;
+typedef struct std::array<float, k_max_motors> MotorCoordinates;
+
 #endif
@@ -19,16 +19,104 @@
 
 #include "mri.h"
 
+#include <new>
+#include <stdlib.h>
+
 using std::string;
-#include <vector>
 
 // A block represents a movement, it's length for each stepper motor, and the corresponding acceleration curves.
 // It's stacked on a queue, and that queue is then executed in order, to move the motors.
 // Most of the accel math is also done in this class
 // And GCode objects for use in on_gcode_execute are also help in here
 
+// Gcodes attached to a block are kept in a list of nodes, when a block is cleared the nodes go back to a pool shared by all blocks
+// instead of the heap. So a block only needs one pointer for them, and streaming moves does not churn the heap
+struct AttachedGcode {
+    AttachedGcode(const Gcode& gcode) : gcode(gcode), next(nullptr) {}
+    Gcode gcode;
+    AttachedGcode *next;
+};
+
+// memory of the released nodes, linked through their first word. Only used from the main loop
+static void *gcode_pool= nullptr;
+static size_t gcode_pool_size= 0;
+
+static AttachedGcode *new_attached_gcode(const Gcode& gcode)
+{
+    void *mem= gcode_pool;
+    if(mem != nullptr) {
+        gcode_pool= *static_cast<void **>(mem);
+    }else{
+        mem= ::operator new(sizeof(AttachedGcode));
+        gcode_pool_size++;
+    }
+    return new(mem) AttachedGcode(gcode);
+}
+
+static void delete_attached_gcode(AttachedGcode *node)
+{
+    node->~AttachedGcode();
+    *reinterpret_cast<void **>(node)= gcode_pool;
+    gcode_pool= node;
+}
+
+RasterLine *RasterLine::create(uint16_t size)
+{
+    RasterLine *line= static_cast<RasterLine *>(malloc(sizeof(RasterLine) + size));
+    if(line == nullptr) return nullptr;
+    line->references= 1;
+    line->size= size;
+    return line;
+}
+
+void RasterLine::release()
+{
+    if(--references == 0) free(this);
+}
+
+// the raster side table, a slice for each slot of the queue. Only used from the main loop
+static RasterSlice *raster_slices= nullptr;
+static unsigned int raster_slices_size= 0;
+
+void Block::set_raster(unsigned int queue_index, RasterLine *line, uint16_t first_pixel, uint16_t pixel_count)
+{
+    if(queue_index >= raster_slices_size) {
+        // on the first G7, or the queue has grown since on a config reload
+        unsigned int size= THEKERNEL->conveyor->get_queue_size();
+        RasterSlice *slices= static_cast<RasterSlice *>(realloc(raster_slices, size * sizeof(RasterSlice)));
+        if(slices == nullptr) return; // the block is lasered at its S value instead
+        raster_slices= slices;
+        raster_slices_size= size;
+    }
+    raster_slices[queue_index]= {line->share(), first_pixel, pixel_count};
+    raster_slot= queue_index + 1;
+}
+
+const RasterSlice *Block::get_raster() const
+{
+    return raster_slot != 0 ? &raster_slices[raster_slot - 1] : nullptr;
+}
+
+// The acceleration rate for the trapezoid generator. Depending on the slope of the line average travel per step event changes.
+// For a line along one axis the travel per step event is equal to the travel/step in the particular axis. For a 45 degree line
+// the steppers of both axes might step for every step event. Travel per step event is then sqrt(travel_x^2+travel_y^2).
+// To generate trapezoids with contant acceleration between blocks the rate_delta must be computed specifically for each line
+// to compensate for this phenomenon. It is worked out when needed rather than kept in the block, to keep the queue small
+float Block::get_rate_delta() const
+{
+    return (this->steps_event_count * this->acceleration) / (this->millimeters * THEKERNEL->acceleration_ticks_per_second); // (step/s/acceleration_tick)
+}
+
+// number of nodes allocated for attached gcodes, in use or pooled
+size_t Block::get_gcode_pool_size()
+{
+    return gcode_pool_size;
+}
+
 Block::Block()
 {
+    gcodes= nullptr;
+    raster_slot= 0;
     clear();
 }
 
@@ -36,8 +124,15 @@ void Block::clear()
 {
     //commands.clear();
     //travel_distances.clear();
-    gcodes.clear();
-    std::vector<Gcode>().swap(gcodes); // this resizes the vector releasing its memory
+    while(gcodes != nullptr) {
+        AttachedGcode *next= gcodes->next;
+        delete_attached_gcode(gcodes);
+        gcodes= next;
+    }
+    if(raster_slot != 0) {
+        raster_slices[raster_slot - 1].line->release();
+        raster_slot= 0;
+    }
 
     this->steps.fill(0);
 
@@ -47,23 +142,25 @@ void Block::clear()
     millimeters         = 0.0F;
     entry_speed         = 0.0F;
     exit_speed          = 0.0F;
-    rate_delta          = 0.0F;
     acceleration        = 100.0F; // we don't want to get devide by zeroes if this is not set
+    s_value             = -1.0F;
     initial_rate        = -1;
     final_rate          = -1;
     accelerate_until    = 0;
     decelerate_after    = 0;
     direction_bits      = 0;
+    s_curve_ramp        = 0;
     recalculate_flag    = false;
     nominal_length_flag = false;
     max_entry_speed     = 0.0F;
     is_ready            = false;
+    is_g123             = false;
     times_taken         = 0;
 }
 
 void Block::debug()
 {
-    THEKERNEL->streams->printf("%p: steps:X%04lu Y%04lu Z%04lu(max:%4lu) nominal:r%10lu/s%6.1f mm:%9.6f rdelta:%8f acc:%5lu dec:%5lu rates:%10lu>%10lu  entry/max: %10.4f/%10.4f taken:%d ready:%d recalc:%d nomlen:%d\r\n",
+    THEKERNEL->streams->printf("%p: steps:X%04lu Y%04lu Z%04lu(max:%4lu) nominal:r%10lu/s%6.1f mm:%9.6f acceleration:%8f acc:%5lu dec:%5lu rates:%10lu>%10lu  entry/max: %10.4f/%10.4f taken:%d ready:%d recalc:%d nomlen:%d\r\n",
                                this,
                                this->steps[0],
                                this->steps[1],
@@ -72,7 +169,7 @@ void Block::debug()
                                this->nominal_rate,
                                this->nominal_speed,
                                this->millimeters,
-                               this->rate_delta,
+                               this->acceleration,
                                this->accelerate_until,
                                this->decelerate_after,
                                this->initial_rate,
@@ -107,7 +204,7 @@ void Block::calculate_trapezoid( float entryspeed, float exitspeed )
     this->final_rate   = ceilf(this->nominal_rate * exitspeed  / this->nominal_speed);   // (step/s)
 
     // How many steps to accelerate and decelerate
-    float acceleration_per_second = this->rate_delta * THEKERNEL->acceleration_ticks_per_second; // ( step/s^2)
+    float acceleration_per_second = this->get_rate_delta() * THEKERNEL->acceleration_ticks_per_second; // ( step/s^2)
     int accelerate_steps = ceilf( this->estimate_acceleration_distance( this->initial_rate, this->nominal_rate, acceleration_per_second ) );
     int decelerate_steps = floorf( this->estimate_acceleration_distance( this->nominal_rate, this->final_rate,  -acceleration_per_second ) );
 
@@ -202,10 +299,11 @@ float Block::forward_pass(float prev_max_exit_speed)
         prev_max_exit_speed = max_entry_speed;
 
     if (prev_max_exit_speed <= entry_speed) {
-        // accel limited
+        // accel limited, or entering at max_entry_speed as the exit of the previous block was clipped to it above
         entry_speed = prev_max_exit_speed;
-        // since we're now acceleration or cruise limited
-        // we don't need to recalculate our entry speed anymore
+        // since we're now acceleration, junction or cruise limited
+        // we don't need to recalculate our entry speed anymore, this block is optimally planned as Grbl's
+        // block_buffer_planned and the reverse pass stops at it
         recalculate_flag = false;
     }
     // else
@@ -236,9 +334,13 @@ float Block::max_exit_speed()
 // Gcodes are attached to their respective blocks so that on_gcode_execute can be called with it
 void Block::append_gcode(Gcode* gcode)
 {
-    Gcode new_gcode = *gcode;
-    new_gcode.strip_parameters(); // optimization to save memory we strip off the XYZIJK parameters from the saved command
-    gcodes.push_back(new_gcode);
+    AttachedGcode *node= new_attached_gcode(*gcode);
+    node->gcode.strip_parameters(); // optimization to save memory we strip off the XYZIJK parameters from the saved command
+
+    // keep them in the order they were received, there are rarely more than one or two
+    AttachedGcode **last= &gcodes;
+    while(*last != nullptr) last= &(*last)->next;
+    *last= node;
 }
 
 void Block::begin()
@@ -251,8 +353,8 @@ void Block::begin()
     times_taken = -1;
 
     // execute all the gcodes related to this block
-    for(unsigned int index = 0; index < gcodes.size(); index++)
-        THEKERNEL->call_event(ON_GCODE_EXECUTE, &(gcodes[index]));
+    for(AttachedGcode *node = gcodes; node != nullptr; node = node->next)
+        THEKERNEL->call_event(ON_GCODE_EXECUTE, &(node->gcode));
 
 
     THEKERNEL->call_event(ON_BLOCK_BEGIN, this);
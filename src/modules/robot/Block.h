@@ -8,11 +8,32 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
-#include <vector>
-#include <bitset>
 #include "ActuatorCoordinates.h"
 
+#include <stdint.h>
+
 class Gcode;
+struct AttachedGcode;
+
+// The pixels of a G7 raster line, the laser power of each from 0 to 255. It is shared by the blocks the line is cut into
+// and freed when the last of them is cleared, references are only taken and released in the main loop
+struct RasterLine {
+    static RasterLine *create(uint16_t size);
+    RasterLine *share() { ++references; return this; }
+    void release();
+    uint8_t *pixels() { return reinterpret_cast<uint8_t *>(this + 1); }
+
+    uint16_t references;
+    uint16_t size;
+};
+
+// The part of a raster line a block moves over. They are kept in a side table with a slot for each block of the queue,
+// allocated on the first G7, so the blocks of a machine without a laser do not carry them
+struct RasterSlice {
+    RasterLine *line;
+    uint16_t first_pixel;
+    uint16_t pixel_count;
+};
 
 class Block {
     public:
@@ -40,17 +61,24 @@ class Block {
 
         void begin();
 
-        std::vector<Gcode> gcodes;
+        float get_rate_delta() const;
 
-        std::array<uint32_t, k_max_actuators> steps; // Number of steps for each axis for this block
+        void set_raster(unsigned int queue_index, RasterLine *line, uint16_t first_pixel, uint16_t pixel_count);
+        const RasterSlice *get_raster() const;
+
+        static size_t get_gcode_pool_size();
+
+        AttachedGcode *gcodes;    // Gcodes to execute when this block begins, a list of nodes from a pool shared by all blocks
+
+        std::array<uint32_t, k_max_motors> steps; // Number of steps for each motor for this block, the actuators then the extruders
         uint32_t steps_event_count;  // Steps for the longest axis
         uint32_t nominal_rate;       // Nominal rate in steps per second
         float nominal_speed;      // Nominal speed in mm per second
         float millimeters;        // Distance for this move
         float entry_speed;
         float exit_speed;
-        float rate_delta;         // Number of steps to add to the speed for each acceleration tick
         float acceleration;       // the acceleratoin for this block
+        float s_value;            // S of the move this block is part of, for the laser, -1 if no move has had one yet
         uint32_t initial_rate;       // Initial speed in steps per second
         uint32_t final_rate;         // Final speed in steps per second
         uint32_t accelerate_until;   // Stop accelerating after this number of steps
@@ -58,15 +86,21 @@ class Block {
 
         float max_entry_speed;
 
-        int16_t times_taken;    // A block can be "taken" by any number of modules, and the next block is not moved to until all the modules have "released" it. This value serves as a tracker.
+        // the small fields are kept together at the end so they pack without padding
+        uint16_t raster_slot;   // 1 + the slot of the raster side table holding the part of a G7 line this block moves over, 0 if none
+
+        int8_t times_taken;     // A block can be "taken" by any number of modules, and the next block is not moved to until all the modules have "released" it. This value serves as a tracker.
+        uint8_t direction_bits; // Direction for each motor in bit form, bit i for motor i, relative to the direction port's mask
+        uint8_t s_curve_ramp;   // the 256ths of a speed change the acceleration ramps for at each end, 0 for constant acceleration
 
-        std::bitset<k_max_actuators> direction_bits;     // Direction for each axis in bit form, relative to the direction port's mask
         struct {
             bool recalculate_flag:1;             // Planner flag to recalculate trapezoids on entry junction
             bool nominal_length_flag:1;          // Planner flag for nominal speed always reached
             bool is_ready:1;
+            bool is_g123:1;                      // part of a G1, G2 or G3, the laser fires on these
         };
 };
 
+static_assert(k_max_motors <= 8, "Block::direction_bits too small for k_max_motors");
 
 #endif
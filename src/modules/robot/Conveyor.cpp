@@ -17,10 +17,12 @@ using namespace std;
 #include "Block.h"
 #include "Conveyor.h"
 #include "Planner.h"
+#include "Robot.h"
 #include "mri.h"
 #include "checksumm.h"
 #include "Config.h"
 #include "libs/StreamOutputPool.h"
+#include "libs/LoopLatency.h"
 #include "ConfigValue.h"
 
 #define planner_queue_size_checksum CHECKSUM("planner_queue_size")
@@ -91,6 +93,9 @@ void Conveyor::on_idle(void* argument){
             queue.consume_tail();
         }
     }
+
+    // fill the room made with the segments still to do of the last line or arc
+    THEKERNEL->robot->queue_pending_segments(false);
 }
 
 /*
@@ -113,12 +118,15 @@ void Conveyor::on_idle(void* argument){
 
 void Conveyor::on_main_loop(void*)
 {
+    // the head block may have the gcode of a line or arc attached whose segments are not queued yet
+    THEKERNEL->robot->queue_pending_segments(false);
+
     if (running)
         return;
 
     if (queue.is_empty())
     {
-        if (queue.head_ref()->gcodes.size())
+        if (queue.head_ref()->gcodes != nullptr)
         {
             queue_head_block();
             ensure_running();
@@ -136,6 +144,8 @@ void Conveyor::on_config_reload(void* argument)
 
 void Conveyor::append_gcode(Gcode* gcode)
 {
+    // it has to go after the rest of the last line or arc
+    THEKERNEL->robot->queue_pending_segments(true);
     queue.head_ref()->append_gcode(gcode);
 }
 
@@ -170,6 +180,10 @@ void Conveyor::on_block_end(void* block)
 // Wait for the queue to be empty
 void Conveyor::wait_for_empty_queue()
 {
+    THEKERNEL->robot->queue_pending_segments(true);
+    if (queue.is_empty()) return;
+
+    BlockingWait wait("wait_for_empty_queue", __builtin_return_address(0));
     while (!queue.is_empty()) {
         ensure_running();
         THEKERNEL->call_event(ON_IDLE, this);
@@ -182,9 +196,12 @@ void Conveyor::wait_for_empty_queue()
 void Conveyor::queue_head_block()
 {
     // upstream caller will block on this until there is room in the queue
-    while (queue.is_full()) {
-        ensure_running();
-        THEKERNEL->call_event(ON_IDLE, this);
+    if (queue.is_full()) {
+        BlockingWait wait("queue_head_block", __builtin_return_address(0));
+        while (queue.is_full()) {
+            ensure_running();
+            THEKERNEL->call_event(ON_IDLE, this);
+        }
     }
 
     if(halted) {
@@ -222,6 +239,8 @@ void Conveyor::ensure_running()
 
 void Conveyor::flush_queue()
 {
+    // the rest of the last line or arc is dropped too
+    THEKERNEL->robot->discard_pending_segments();
     flush = true;
     wait_for_empty_queue();
     flush = false;
@@ -35,6 +35,9 @@ public:
     void wait_for_empty_queue();
     bool is_queue_empty() { return queue.is_empty(); };
     bool is_queue_full() { return queue.is_full(); };
+    unsigned int get_queue_size() const { return queue.length; };
+    // how many more blocks can be queued before queue_head_block() has to wait
+    unsigned int get_queue_free() const { return (queue.tail_i + queue.length - queue.head_i - 1) % queue.length; };
 
     void ensure_running(void);
 
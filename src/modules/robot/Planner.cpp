@@ -28,6 +28,7 @@ using namespace std;
 
 #define acceleration_checksum          CHECKSUM("acceleration")
 #define z_acceleration_checksum        CHECKSUM("z_acceleration")
+#define jerk_checksum                  CHECKSUM("jerk")
 #define junction_deviation_checksum    CHECKSUM("junction_deviation")
 #define z_junction_deviation_checksum  CHECKSUM("z_junction_deviation")
 #define minimum_planner_speed_checksum CHECKSUM("minimum_planner_speed")
@@ -39,6 +40,8 @@ using namespace std;
 Planner::Planner()
 {
     clear_vector_float(this->previous_unit_vec);
+    for (size_t i = 0; i < k_max_actuators; i++)
+        this->previous_actuator_ratio[i] = 0.0F;
     config_load();
 }
 
@@ -47,6 +50,7 @@ void Planner::config_load()
 {
     this->acceleration = THEKERNEL->config->value(acceleration_checksum)->by_default(100.0F )->as_number(); // Acceleration is in mm/s^2
     this->z_acceleration = THEKERNEL->config->value(z_acceleration_checksum)->by_default(0.0F )->as_number(); // disabled by default
+    this->jerk = THEKERNEL->config->value(jerk_checksum)->by_default(0.0F )->as_number(); // jerk is in mm/s^3, disabled by default
 
     this->junction_deviation = THEKERNEL->config->value(junction_deviation_checksum)->by_default(0.05F)->as_number();
     this->z_junction_deviation = THEKERNEL->config->value(z_junction_deviation_checksum)->by_default(-1)->as_number(); // disabled by default
@@ -54,8 +58,31 @@ void Planner::config_load()
 }
 
 
+// The most acceleration along a direction the motors with an acceleration of their own allow, the motors without one are
+// held to default_acceleration, as Grbl's limit_value_by_axis_maximum(). ratio[] is the mm each motor moves per mm along it
+static float limit_acceleration_by_motors(const float ratio[], size_t n_motors, float default_acceleration)
+{
+    float limit = default_acceleration;
+    bool own = false, other = false;
+    for (size_t i = 0; i < n_motors; i++) {
+        if(ratio[i] == 0.0F) continue;
+        float motor_acceleration = THEKERNEL->robot->motors[i]->get_acceleration();
+        if(motor_acceleration <= 0.0F) {
+            other = true;
+            continue;
+        }
+        float motor_limit = motor_acceleration / fabsf(ratio[i]);
+        limit = own || other ? min(limit, motor_limit) : motor_limit;
+        own = true;
+    }
+    // the default is only a limit when a motor without an acceleration of its own moves
+    if(other) limit = min(limit, default_acceleration);
+    return limit;
+}
+
 // Append a block to the queue, compute it's speed factors
-void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s, float distance, float unit_vec[] )
+void Planner::append_block( MotorCoordinates &motor_pos, float rate_mm_s, float distance, float unit_vec[], float s_value, bool is_g123,
+                            RasterLine *raster, uint16_t first_pixel, uint16_t pixel_count )
 {
     float acceleration, junction_deviation;
 
@@ -64,33 +91,70 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
 
 
     // Direction bits
-    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
-        int steps = THEKERNEL->robot->actuators[i]->steps_to_target(actuator_pos[i]);
+    size_t n_motors = THEKERNEL->robot->motors.size();
+    float motor_ratio[k_max_motors]; // mm each motor moves per mm of the block, signed
+    block->direction_bits = 0;
+    for (size_t i = 0; i < n_motors; i++) {
+        StepperMotor *motor = THEKERNEL->robot->motors[i];
+        int steps = motor->steps_to_target(motor_pos[i]);
 
-        block->direction_bits[i] = (steps < 0) ? 1 : 0;
+        if(steps < 0) block->direction_bits |= 1 << i;
 
         // Update current position
-        THEKERNEL->robot->actuators[i]->last_milestone_steps += steps;
-        THEKERNEL->robot->actuators[i]->last_milestone_mm = actuator_pos[i];
+        motor->last_milestone_steps += steps;
+        motor->last_milestone_mm = motor_pos[i];
 
         block->steps[i] = labs(steps);
+        motor_ratio[i] = distance > 0.0F ? steps / (motor->get_steps_per_mm() * distance) : 0.0F;
     }
 
     acceleration = this->acceleration;
     junction_deviation = this->junction_deviation;
 
     // use either regular acceleration or a z only move accleration
-    if(block->steps[ALPHA_STEPPER] == 0 && block->steps[BETA_STEPPER] == 0) {
+    if(block->steps[ALPHA_STEPPER] == 0 && block->steps[BETA_STEPPER] == 0 && block->steps[GAMMA_STEPPER] > 0) {
         // z only move
         if(this->z_acceleration > 0.0F) acceleration = this->z_acceleration;
         if(this->z_junction_deviation >= 0.0F) junction_deviation = this->z_junction_deviation;
     }
 
+    // the motors with an acceleration of their own, the extruders and any actuator configured with one, are kept under it,
+    // so a block only they move in is at what they allow along it and a slow axis does not hold back the others
+    acceleration = limit_acceleration_by_motors(motor_ratio, n_motors, acceleration);
+
+    // With a jerk the acceleration ramps up to its peak and back down, so a speed change takes longer than at the constant
+    // acceleration the trapezoid is planned with. The block is planned with the constant acceleration that changes the speed
+    // from 0 to its nominal speed in that time, so the peak of the S-curve is the acceleration. The Stepper ramps for the same
+    // fraction of any smaller change in the block, so the peak never goes over the acceleration but the jerk does: a change of
+    // a tenth of the nominal speed ramps ten times faster. So jerk is an approximate setting rather than a limit, planning the
+    // acceleration of each phase for its own change would need the entry and exit speeds, which are not known here
+    block->s_curve_ramp = 0;
+    if(this->jerk > 0.0F && rate_mm_s > 0.0F) {
+        float ramp_time = acceleration / this->jerk; // to ramp up to the acceleration
+        if(rate_mm_s >= acceleration * ramp_time) {
+            // ramps up, holds at the acceleration and ramps down, taking rate_mm_s / acceleration + ramp_time, rounded up to
+            // the next 256th it ramps a little longer so at a little under the jerk
+            block->s_curve_ramp = ceilf(256.0F * ramp_time / (rate_mm_s / acceleration + ramp_time));
+            acceleration *= 1.0F - block->s_curve_ramp / 256.0F;
+        } else {
+            // too small a change to get to the acceleration, ramps up and straight back down at the jerk
+            block->s_curve_ramp = 128;
+            acceleration = sqrtf(rate_mm_s * this->jerk) / 2.0F;
+        }
+    }
+
     block->acceleration = acceleration; // save in block
 
+    // for the laser, so its power follows the queue instead of the gcodes attached to it
+    block->s_value = s_value;
+    block->is_g123 = is_g123;
+    if(raster != nullptr) {
+        block->set_raster(THEKERNEL->conveyor->queue.head_i, raster, first_pixel, pixel_count);
+    }
+
     // Max number of steps, for all axes
     uint32_t steps_event_count = 0;
-    for (size_t s = 0; s < THEKERNEL->robot->actuators.size(); s++) {
+    for (size_t s = 0; s < n_motors; s++) {
         steps_event_count = std::max(steps_event_count, block->steps[s]);
     }
     block->steps_event_count = steps_event_count;
@@ -107,15 +171,6 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
         block->nominal_rate  = 0;
     }
 
-    // Compute the acceleration rate for the trapezoid generator. Depending on the slope of the line
-    // average travel per step event changes. For a line along one axis the travel per step event
-    // is equal to the travel/step in the particular axis. For a 45 degree line the steppers of both
-    // axes might step for every step event. Travel per step event is then sqrt(travel_x^2+travel_y^2).
-    // To generate trapezoids with contant acceleration between blocks the rate_delta must be computed
-    // specifically for each line to compensate for this phenomenon:
-    // Convert universal acceleration for direction-dependent stepper rate change parameter
-    block->rate_delta = (block->steps_event_count * acceleration) / (distance * THEKERNEL->acceleration_ticks_per_second); // (step/min/acceleration_tick)
-
     // Compute maximum allowable entry speed at junction by centripetal acceleration approximation.
     // Let a circle be tangent to both previous and current path line segments, where the junction
     // deviation is defined as the distance from the junction to the closest edge of the circle,
@@ -130,7 +185,16 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     // and this allows one to stop with little to no decleration in many cases. This is particualrly bad on leadscrew based systems that will skip steps.
     float vmax_junction = minimum_planner_speed; // Set default max junction speed
 
-    if (!THEKERNEL->conveyor->is_queue_empty()) {
+    // a block only the extruders move in, a retract or unretract, starts or ends with the actuators stopped, so the junction
+    // on either side of it is taken at the minimum speed like the empty block that used to be between them
+    size_t n_actuators = THEKERNEL->robot->actuators.size();
+    bool moves_actuators = false, previous_moved_actuators = false;
+    for (size_t i = 0; i < n_actuators; i++) {
+        if(motor_ratio[i] != 0.0F) moves_actuators = true;
+        if(this->previous_actuator_ratio[i] != 0.0F) previous_moved_actuators = true;
+    }
+
+    if (!THEKERNEL->conveyor->is_queue_empty() && moves_actuators && previous_moved_actuators) {
         float previous_nominal_speed = THEKERNEL->conveyor->queue.item_ref(THEKERNEL->conveyor->queue.prev(THEKERNEL->conveyor->queue.head_i))->nominal_speed;
 
         if (previous_nominal_speed > 0.0F && junction_deviation > 0.0F) {
@@ -147,7 +211,8 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
                 if (cos_theta > -0.95F) {
                     // Compute maximum junction velocity based on maximum acceleration and junction deviation
                     float sin_theta_d2 = sqrtf(0.5F * (1.0F - cos_theta)); // Trig half angle identity. Always positive.
-                    vmax_junction = min(vmax_junction, sqrtf(acceleration * junction_deviation * sin_theta_d2 / (1.0F - sin_theta_d2)));
+                    float junction_acceleration = junction_acceleration_limit(motor_ratio, acceleration);
+                    vmax_junction = min(vmax_junction, sqrtf(junction_acceleration * junction_deviation * sin_theta_d2 / (1.0F - sin_theta_d2)));
                 }
             }
         }
@@ -174,6 +239,8 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
 
     // Update previous path unit_vector and nominal speed
     memcpy(this->previous_unit_vec, unit_vec, sizeof(previous_unit_vec)); // previous_unit_vec[] = unit_vec[]
+    for (size_t i = 0; i < k_max_actuators; i++)
+        this->previous_actuator_ratio[i] = i < n_actuators ? motor_ratio[i] : 0.0F;
 
     // Math-heavy re-computing of the whole queue to take the new
     this->recalculate();
@@ -184,6 +251,26 @@ void Planner::append_block( ActuatorCoordinates &actuator_pos, float rate_mm_s,
     THEKERNEL->conveyor->queue_head_block();
 }
 
+// The acceleration the actuators allow through the junction with the previous block, in the direction their speeds change
+// in there as Grbl does, the extruders are left out as they have no jerk limit of their own. When no actuator has an
+// acceleration of its own it is the acceleration of the block
+float Planner::junction_acceleration_limit(const float motor_ratio[], float acceleration) const
+{
+    size_t n_actuators = THEKERNEL->robot->actuators.size();
+    float change[k_max_actuators];
+    float length = 0.0F;
+    for (size_t i = 0; i < n_actuators; i++) {
+        change[i] = motor_ratio[i] - this->previous_actuator_ratio[i];
+        length += change[i] * change[i];
+    }
+    if(length <= 0.0F) return acceleration;
+
+    length = sqrtf(length);
+    for (size_t i = 0; i < n_actuators; i++)
+        change[i] /= length;
+    return limit_acceleration_by_motors(change, n_actuators, acceleration);
+}
+
 void Planner::recalculate()
 {
     Conveyor::Queue_t &queue = THEKERNEL->conveyor->queue;
@@ -222,6 +309,11 @@ void Planner::recalculate()
     /*
      * Step 1:
      * For each block, given the exit speed and acceleration, find the maximum entry speed
+     *
+     * we stop at the first block that is not flagged for recalculation, the forward pass clears the flag of a block that
+     * is accel limited or enters at its max_entry_speed, and nothing before it can go any faster by adding this block.
+     * So this only walks the blocks that are still decel limited, those within the stopping distance of the end of the
+     * queue, and when that is shorter than the queue the walk does not grow with planner_queue_size
      */
 
     float entry_speed = minimum_planner_speed;
@@ -10,12 +10,14 @@
 
 #include "ActuatorCoordinates.h"
 class Block;
+struct RasterLine;
 
 class Planner
 {
 public:
     Planner();
-    void append_block(ActuatorCoordinates &target, float rate_mm_s, float distance, float unit_vec[] );
+    void append_block(MotorCoordinates &target, float rate_mm_s, float distance, float unit_vec[], float s_value, bool is_g123,
+                      RasterLine *raster= nullptr, uint16_t first_pixel= 0, uint16_t pixel_count= 0 );
     float max_allowable_speed( float acceleration, float target_velocity, float distance);
     void recalculate();
     Block *get_current_block();
@@ -23,13 +25,17 @@ public:
     float get_acceleration() const { return acceleration; }
     float get_z_acceleration() const { return z_acceleration > 0.0F ? z_acceleration : acceleration; }
 
-    friend class Robot; // for acceleration, junction deviation, minimum_planner_speed
+    friend class Robot; // for acceleration, jerk, junction deviation, minimum_planner_speed
 
 private:
     void config_load();
+    float junction_acceleration_limit(const float motor_ratio[], float acceleration) const;
+
     float previous_unit_vec[3];
+    float previous_actuator_ratio[k_max_actuators]; // mm each actuator moved per mm of the previous block, signed
     float acceleration;          // Setting
     float z_acceleration;        // Setting
+    float jerk;                  // Setting
     float junction_deviation;    // Setting
     float z_junction_deviation;  // Setting
     float minimum_planner_speed; // Setting
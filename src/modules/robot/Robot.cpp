@@ -16,7 +16,9 @@ using std::string;
 
 #include "Planner.h"
 #include "Conveyor.h"
+#include "Block.h"
 #include "Robot.h"
+#include "Stepper.h"
 #include "nuts_bolts.h"
 #include "Pin.h"
 #include "StepperMotor.h"
@@ -45,7 +47,11 @@ using std::string;
 #define  default_feed_rate_checksum          CHECKSUM("default_feed_rate")
 #define  mm_per_line_segment_checksum        CHECKSUM("mm_per_line_segment")
 #define  delta_segments_per_second_checksum  CHECKSUM("delta_segments_per_second")
+#define  adaptive_segment_error_checksum     CHECKSUM("adaptive_segment_error")
 #define  mm_per_arc_segment_checksum         CHECKSUM("mm_per_arc_segment")
+#define  mm_max_arc_error_checksum           CHECKSUM("mm_max_arc_error")
+#define  mm_min_arc_segment_checksum         CHECKSUM("mm_min_arc_segment")
+#define  mm_max_arc_segment_checksum         CHECKSUM("mm_max_arc_segment")
 #define  arc_correction_checksum             CHECKSUM("arc_correction")
 #define  x_axis_max_speed_checksum           CHECKSUM("x_axis_max_speed")
 #define  y_axis_max_speed_checksum           CHECKSUM("y_axis_max_speed")
@@ -102,6 +108,7 @@ using std::string;
 #define SPINDLE_DIRECTION_CCW 1
 
 #define ARC_ANGULAR_TRAVEL_EPSILON 5E-7 // Float (radians)
+#define ADAPTIVE_MIN_SEGMENT_MM 0.1F // adaptive segments are not split any shorter than this, even near a singularity
 
 // The Robot converts GCodes into actual movements, and then adds them to the Planner, which passes them to the Conveyor so they can be added to the queue
 // It takes care of cutting arcs into segments, same thing for line that are too long
@@ -111,6 +118,9 @@ Robot::Robot()
     this->inch_mode = false;
     this->absolute_mode = true;
     this->motion_mode =  MOTION_MODE_SEEK;
+    this->is_g123 = false;
+    this->s_value = -1.0F;
+    this->raster.line = nullptr;
     this->select_plane(X_AXIS, Y_AXIS, Z_AXIS);
     clear_vector(this->last_milestone);
     clear_vector(this->last_machine_position);
@@ -122,12 +132,19 @@ Robot::Robot()
     this->g92_offset = wcs_t(0.0F, 0.0F, 0.0F);
     this->next_command_is_MCS = false;
     this->disable_segmentation= false;
+    this->segmenter.next= 0;
+    this->segmenter.busy= false;
+    this->segmenter.step= 1E6F; // first try a whole line as one segment
+    this->extrusion.motor= -1;
 }
 
 //Called when the module has just been loaded
 void Robot::on_module_loaded()
 {
-    this->register_for_event(ON_GCODE_RECEIVED);
+    // every G, moves and settings wait for the segments of the last line or arc, and the M codes it handles
+    this->register_for_gcode('G');
+    for (int m : {0, 2, 30, 92, 114, 120, 121, 203, 204, 205, 220, 400, 500, 503, 665})
+        this->register_for_gcode('M', m);
 
     // Configuration
     this->load_config();
@@ -138,7 +155,8 @@ void Robot::on_module_loaded()
     CHECKSUM(X "_dir_pin"),         \
     CHECKSUM(X "_en_pin"),          \
     CHECKSUM(X "_steps_per_mm"),    \
-    CHECKSUM(X "_max_rate")         \
+    CHECKSUM(X "_max_rate"),        \
+    CHECKSUM(X "_acceleration")     \
 }
 
 void Robot::load_config()
@@ -179,7 +197,11 @@ void Robot::load_config()
     this->seek_rate           = THEKERNEL->config->value(default_seek_rate_checksum   )->by_default(  100.0F)->as_number();
     this->mm_per_line_segment = THEKERNEL->config->value(mm_per_line_segment_checksum )->by_default(    0.0F)->as_number();
     this->delta_segments_per_second = THEKERNEL->config->value(delta_segments_per_second_checksum )->by_default(0.0f   )->as_number();
+    this->adaptive_segment_error = THEKERNEL->config->value(adaptive_segment_error_checksum )->by_default(0.0F )->as_number();
     this->mm_per_arc_segment  = THEKERNEL->config->value(mm_per_arc_segment_checksum  )->by_default(    0.5f)->as_number();
+    this->mm_max_arc_error    = THEKERNEL->config->value(mm_max_arc_error_checksum    )->by_default(    0.0F)->as_number();
+    this->mm_min_arc_segment  = THEKERNEL->config->value(mm_min_arc_segment_checksum  )->by_default(    0.0F)->as_number();
+    this->mm_max_arc_segment  = THEKERNEL->config->value(mm_max_arc_segment_checksum  )->by_default(    0.0F)->as_number();
     this->arc_correction      = THEKERNEL->config->value(arc_correction_checksum      )->by_default(    5   )->as_number();
 
     this->max_speeds[X_AXIS]  = THEKERNEL->config->value(x_axis_max_speed_checksum    )->by_default(60000.0F)->as_number() / 60.0F;
@@ -189,7 +211,7 @@ void Robot::load_config()
     this->segment_z_moves     = THEKERNEL->config->value(segment_z_moves_checksum     )->by_default(true)->as_bool();
 
     // Make our 3 StepperMotors
-    uint16_t const checksums[][5] = {
+    uint16_t const checksums[][6] = {
         ACTUATOR_CHECKSUMS("alpha"),
         ACTUATOR_CHECKSUMS("beta"),
         ACTUATOR_CHECKSUMS("gamma"),
@@ -212,8 +234,12 @@ void Robot::load_config()
 
         actuators[a]->change_steps_per_mm(THEKERNEL->config->value(checksums[a][3])->by_default(a == 2 ? 2560.0F : 80.0F)->as_number());
         actuators[a]->set_max_rate(THEKERNEL->config->value(checksums[a][4])->by_default(30000.0F)->as_number());
+        actuators[a]->set_acceleration(THEKERNEL->config->value(checksums[a][5])->by_default(0.0F)->as_number()); // 0 uses acceleration
     }
 
+    // the extruders add their motors after these
+    this->motors.assign(actuators.begin(), actuators.end());
+
     check_max_actuator_speeds(); // check the configs are sane
 
     // initialise actuator positions to current cartesian position (X0 Y0 Z0)
@@ -328,6 +354,32 @@ void Robot::check_max_actuator_speeds()
     }
 }
 
+// Add a motor for the planner to move along with the actuators, an extruder, returns its index in motors or -1 if there is no
+// room for it in a block, see MAX_ROBOT_EXTRUDERS
+int Robot::register_motor(StepperMotor *motor)
+{
+    if(motors.size() >= k_max_motors) return -1;
+
+    motors.push_back(motor);
+    motor->attach(THEKERNEL->stepper, &Stepper::stepper_motor_finished_move);
+    return motors.size() - 1;
+}
+
+// Queue a move of only the given motor by distance mm at rate mm/sec, used by the extruders for firmware retracts
+bool Robot::append_motor_move(int motor, float distance, float rate_mm_s)
+{
+    if(motor < 0 || (size_t)motor >= motors.size() || rate_mm_s <= 0.0F) return false;
+
+    extrusion.motor= motor;
+    extrusion.start= motors[motor]->last_milestone_mm;
+    extrusion.distance= distance;
+    bool moved= append_milestone(last_milestone, rate_mm_s);
+    extrusion.motor= -1;
+
+    if(moved) THEKERNEL->conveyor->ensure_running();
+    return moved;
+}
+
 //A GCode has been received
 //See if the current Gcode line has some orders for us
 void Robot::on_gcode_received(void *argument)
@@ -337,11 +389,20 @@ void Robot::on_gcode_received(void *argument)
     this->motion_mode = -1;
 
     if( gcode->has_g) {
+        if(this->raster.line != nullptr) {
+            // all the blocks of the last G7 have been queued
+            this->raster.line->release();
+            this->raster.line = nullptr;
+        }
+
         switch( gcode->g ) {
             case 0:  this->motion_mode = MOTION_MODE_SEEK;    break;
             case 1:  this->motion_mode = MOTION_MODE_LINEAR;  break;
             case 2:  this->motion_mode = MOTION_MODE_CW_ARC;  break;
             case 3:  this->motion_mode = MOTION_MODE_CCW_ARC; break;
+            case 7: // G7 raster line, a G1 that sets the laser power of each pixel along it
+                if(set_raster(gcode)) this->motion_mode = MOTION_MODE_LINEAR;
+                break;
             case 4: { // G4 pause
                 uint32_t delay_ms = 0;
                 if (gcode->has_letter('P')) {
@@ -518,7 +579,7 @@ void Robot::on_gcode_received(void *argument)
                 }
                 break;
 
-            case 204: // M204 Snnn - set acceleration to nnn, Znnn sets z acceleration
+            case 204: // M204 Snnn - set acceleration to nnn, Znnn sets z acceleration, Jnnn sets jerk, Annn Bnnn Cnnn set actuator accelerations
                 if (gcode->has_letter('S')) {
                     float acc = gcode->get_value('S'); // mm/s^2
                     // enforce minimum
@@ -533,6 +594,22 @@ void Robot::on_gcode_received(void *argument)
                         acc = 0.0F;
                     THEKERNEL->planner->z_acceleration = acc;
                 }
+                if (gcode->has_letter('J')) {
+                    float jerk = gcode->get_value('J'); // mm/s^3
+                    // enforce positive, zero disables it
+                    if (jerk < 0.0F)
+                        jerk = 0.0F;
+                    THEKERNEL->planner->jerk = jerk;
+                }
+                for (size_t i = 0; i < 3 && i < actuators.size(); i++) {
+                    if (gcode->has_letter('A' + i)) {
+                        float acc = gcode->get_value('A' + i); // mm/s^2
+                        // enforce positive, zero uses S
+                        if (acc < 0.0F)
+                            acc = 0.0F;
+                        actuators[i]->set_acceleration(acc);
+                    }
+                }
                 break;
 
             case 205: // M205 Xnnn - set junction deviation, Z - set Z junction deviation, Snnn - Set minimum planner speed, Ynnn - set minimum step rate
@@ -585,7 +662,11 @@ void Robot::on_gcode_received(void *argument)
             case 500: // M500 saves some volatile settings to config override file
             case 503: { // M503 just prints the settings
                 gcode->stream->printf(";Steps per unit:\nM92 X%1.5f Y%1.5f Z%1.5f\n", actuators[0]->steps_per_mm, actuators[1]->steps_per_mm, actuators[2]->steps_per_mm);
-                gcode->stream->printf(";Acceleration mm/sec^2:\nM204 S%1.5f Z%1.5f\n", THEKERNEL->planner->acceleration, THEKERNEL->planner->z_acceleration);
+                gcode->stream->printf(";Acceleration mm/sec^2, Jerk mm/sec^3, ABC actuator acceleration:\nM204 S%1.5f Z%1.5f J%1.5f", THEKERNEL->planner->acceleration, THEKERNEL->planner->z_acceleration, THEKERNEL->planner->jerk);
+                for (size_t i = 0; i < 3 && i < actuators.size(); i++) {
+                    gcode->stream->printf(" %c%1.5f", 'A' + i, actuators[i]->get_acceleration());
+                }
+                gcode->stream->printf("\n");
                 gcode->stream->printf(";X- Junction Deviation, Z- Z junction deviation, S - Minimum Planner speed mm/sec:\nM205 X%1.5f Z%1.5f S%1.5f\n", THEKERNEL->planner->junction_deviation, THEKERNEL->planner->z_junction_deviation, THEKERNEL->planner->minimum_planner_speed);
                 gcode->stream->printf(";Max feedrates in mm/sec, XYZ cartesian, ABC actuator:\nM203 X%1.5f Y%1.5f Z%1.5f",
                                       this->max_speeds[X_AXIS], this->max_speeds[Y_AXIS], this->max_speeds[Z_AXIS]);
@@ -725,6 +806,16 @@ void Robot::process_move(Gcode *gcode)
             this->feed_rate = this->to_millimeters( gcode->get_value('F') );
     }
 
+    // the blocks of this move carry these, the segments still to be queued of the last move were queued before we got here
+    if( gcode->has_letter('S') ) this->s_value = gcode->get_value('S');
+    this->is_g123 = this->motion_mode != MOTION_MODE_SEEK;
+    if(this->raster.line != nullptr) {
+        // the pixels are spread evenly from here to the target
+        memcpy(this->raster.start, this->last_milestone, sizeof(this->raster.start));
+        this->raster.length = sqrtf(powf(target[X_AXIS] - last_milestone[X_AXIS], 2) + powf(target[Y_AXIS] - last_milestone[Y_AXIS], 2) + powf(target[Z_AXIS] - last_milestone[Z_AXIS], 2));
+        this->raster.next_pixel = 0;
+    }
+
     bool moved= false;
     //Perform any physical actions
     switch(this->motion_mode) {
@@ -753,8 +844,10 @@ void Robot::process_move(Gcode *gcode)
 // and continue
 void Robot::distance_in_gcode_is_known(Gcode * gcode)
 {
-    //If the queue is empty, execute immediately, otherwise attach to the last added block
-    THEKERNEL->conveyor->append_gcode(gcode);
+    // the move itself is all in the blocks, the laser power and the extruder steps included, so the gcode only needs to be
+    // attached for on_gcode_execute when it has an E, for the extruder to keep its position. Streaming plain moves then does
+    // not copy each of them into the block and run it through every module at block begin
+    if(gcode->has_letter('E')) THEKERNEL->conveyor->append_gcode(gcode);
 }
 
 // reset the machine position for all axis. Used for homing.
@@ -818,19 +911,24 @@ void Robot::reset_position_from_current_actuator_position()
 // Convert target (in machine coordinates) from millimeters to steps, and append this to the planner
 // target is in machine coordinates without the compensation transform, however we save a last_machine_position that includes
 // all transforms and is what we actually convert to actuator positions
-bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_s)
+// fraction is how much of the move being queued is done at target, the extruder moving with it goes as far along its distance
+bool Robot::append_milestone(const float target[], float rate_mm_s, const ActuatorCoordinates *target_actuator_pos, float fraction)
 {
     float deltas[3];
     float unit_vec[3];
     ActuatorCoordinates actuator_pos;
+    MotorCoordinates motor_pos;
     float transformed_target[3]; // adjust target for bed compensation and WCS offsets
     float millimeters_of_travel;
 
-    // catch negative or zero feed rates and return the same error as GRBL does
-    if(rate_mm_s <= 0.0F) {
-        gcode->is_error= true;
-        gcode->txt_after_ok= (rate_mm_s == 0 ? "Undefined feed rate" : "feed rate < 0");
-        return false;
+    // the motors that do not move stay where they are
+    for (size_t i = 0; i < motors.size(); i++)
+        motor_pos[i]= motors[i]->last_milestone_mm;
+
+    float extrusion_delta= 0.0F;
+    if(extrusion.motor >= 0) {
+        motor_pos[extrusion.motor]= extrusion.start + extrusion.distance * fraction;
+        extrusion_delta= motor_pos[extrusion.motor] - motors[extrusion.motor]->last_milestone_mm;
     }
 
     // unity transform by default
@@ -852,14 +950,24 @@ bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_
 
     // it is unlikely but we need to protect against divide by zero, so ignore insanely small moves here
     // as the last milestone won't be updated we do not actually lose any moves as they will be accounted for in the next move
-    if(millimeters_of_travel < 0.00001F) return false;
+    // unless only the extruder moves, then the block is as long as it moves
+    bool extruder_only= millimeters_of_travel < 0.00001F;
+    if(extruder_only) {
+        if(fabsf(extrusion_delta) < 0.00001F) return false;
+        millimeters_of_travel= fabsf(extrusion_delta);
+        for (int i = 0; i < 3; i++)
+            unit_vec[i] = 0.0F;
+        for (size_t i = 0; i < actuators.size(); i++)
+            actuator_pos[i]= actuators[i]->last_milestone_mm;
 
-    // this is the machine position
-    memcpy(this->last_machine_position, transformed_target, sizeof(this->last_machine_position));
+    } else {
+        // this is the machine position
+        memcpy(this->last_machine_position, transformed_target, sizeof(this->last_machine_position));
 
-    // find distance unit vector
-    for (int i = 0; i < 3; i++)
-        unit_vec[i] = deltas[i] / millimeters_of_travel;
+        // find distance unit vector
+        for (int i = 0; i < 3; i++)
+            unit_vec[i] = deltas[i] / millimeters_of_travel;
+    }
 
     // Do not move faster than the configured cartesian limits
     for (int axis = X_AXIS; axis <= Z_AXIS; axis++) {
@@ -871,25 +979,130 @@ bool Robot::append_milestone(Gcode * gcode, const float target[], float rate_mm_
         }
     }
 
-    // find actuator position given the machine position, use actual adjusted target
-    arm_solution->cartesian_to_actuator( this->last_machine_position, actuator_pos );
+    // find actuator position given the machine position, use actual adjusted target, unless the caller already has
+    if(extruder_only) {
+        // they stay where they are
+    } else if(target_actuator_pos != nullptr) {
+        actuator_pos= *target_actuator_pos;
+    } else {
+        arm_solution->cartesian_to_actuator( this->last_machine_position, actuator_pos );
+    }
+    for (size_t i = 0; i < actuators.size(); i++)
+        motor_pos[i]= actuator_pos[i];
 
     float isecs = rate_mm_s / millimeters_of_travel;
-    // check per-actuator speed limits
-    for (size_t actuator = 0; actuator < actuators.size(); actuator++) {
-        float actuator_rate  = fabsf(actuator_pos[actuator] - actuators[actuator]->last_milestone_mm) * isecs;
-        if (actuator_rate > actuators[actuator]->get_max_rate()) {
-            rate_mm_s *= (actuators[actuator]->get_max_rate() / actuator_rate);
+    // check per-motor speed limits, the extruders included
+    for (size_t motor = 0; motor < motors.size(); motor++) {
+        float motor_rate  = fabsf(motor_pos[motor] - motors[motor]->last_milestone_mm) * isecs;
+        if (motor_rate > motors[motor]->get_max_rate()) {
+            rate_mm_s *= (motors[motor]->get_max_rate() / motor_rate);
             isecs = rate_mm_s / millimeters_of_travel;
         }
     }
 
     // Append the block to the planner
-    THEKERNEL->planner->append_block( actuator_pos, rate_mm_s, millimeters_of_travel, unit_vec );
+    if(raster.line != nullptr) {
+        // the pixels from where the last block ended to where this one does
+        float along= sqrtf(powf(target[X_AXIS] - raster.start[X_AXIS], 2) + powf(target[Y_AXIS] - raster.start[Y_AXIS], 2) + powf(target[Z_AXIS] - raster.start[Z_AXIS], 2));
+        uint16_t end_pixel= raster.length > 0.0F ? min((float)raster.line->size, roundf(raster.line->size * along / raster.length)) : raster.line->size;
+        if(end_pixel < raster.next_pixel) end_pixel= raster.next_pixel;
+        THEKERNEL->planner->append_block( motor_pos, rate_mm_s, millimeters_of_travel, unit_vec, s_value, is_g123, raster.line, raster.next_pixel, end_pixel - raster.next_pixel );
+        raster.next_pixel= end_pixel;
+
+    } else {
+        THEKERNEL->planner->append_block( motor_pos, rate_mm_s, millimeters_of_travel, unit_vec, s_value, is_g123 );
+    }
 
     return true;
 }
 
+// Decode the pixels of a G7, which are base64 after the D that ends the line, into a new raster line
+// eg G7 X20 F3000 S0.8 DAID/QA== is a G1 to X20 over 4 pixels evenly spaced along it, each byte is the fraction of the S
+// power from 0 to 255 the laser fires at over its pixel
+bool Robot::set_raster(Gcode *gcode)
+{
+    const char *data= strchr(gcode->get_command(), 'D');
+    if(data == nullptr || data[1] == '\0') {
+        gcode->is_error= true;
+        gcode->txt_after_ok= "G7 has no pixels";
+        return false;
+    }
+    data++;
+
+    size_t len= strcspn(data, " \t\r\n");
+    RasterLine *line= len * 3 / 4 <= 0xFFFF ? RasterLine::create(len * 3 / 4) : nullptr;
+    if(line == nullptr) {
+        gcode->is_error= true;
+        gcode->txt_after_ok= "Not enough memory for G7";
+        return false;
+    }
+
+    uint8_t *pixels= line->pixels();
+    uint16_t n= 0;
+    uint32_t bits= 0;
+    int nbits= 0;
+    for (size_t i = 0; i < len; i++) {
+        char c= data[i];
+        uint32_t v;
+        if(c >= 'A' && c <= 'Z') v= c - 'A';
+        else if(c >= 'a' && c <= 'z') v= c - 'a' + 26;
+        else if(c >= '0' && c <= '9') v= c - '0' + 52;
+        else if(c == '+') v= 62;
+        else if(c == '/') v= 63;
+        else if(c == '=') break;
+        else {
+            line->release();
+            gcode->is_error= true;
+            gcode->txt_after_ok= "G7 pixels are not base64";
+            return false;
+        }
+        bits= (bits << 6) | v;
+        nbits += 6;
+        if(nbits >= 8) {
+            nbits -= 8;
+            pixels[n++]= (bits >> nbits) & 0xFF;
+        }
+    }
+    line->size= n;
+
+    this->raster.line= line;
+    return true;
+}
+
+// catch negative or zero feed rates and return the same error as GRBL does
+static bool is_valid_rate(Gcode *gcode, float rate_mm_s)
+{
+    if(rate_mm_s <= 0.0F) {
+        gcode->is_error= true;
+        gcode->txt_after_ok= (rate_mm_s == 0 ? "Undefined feed rate" : "feed rate < 0");
+        return false;
+    }
+    return true;
+}
+
+// Ask the enabled extruder how far its motor moves for the E of this move, the planner moves it along with the arm.
+// Returns the rate for the move, the extruder slows it down if it would go over its max volumetric rate, and for a move of
+// only the extruder it gives the rate.
+// NOTE we need to do this before we segment the move, and Extruder won't even see this gcode until after it has been planned
+float Robot::set_extrusion(Gcode *gcode, float rate_mm_s)
+{
+    extrusion.motor= -1;
+    if(!gcode->has_letter('E')) return rate_mm_s;
+
+    pad_extruder_move move;
+    move.gcode= gcode;
+    move.isecs= gcode->millimeters_of_travel < 0.00001F ? 0.0F : rate_mm_s / gcode->millimeters_of_travel;
+    move.motor= -1;
+    if(!PublicData::set_value(extruder_checksum, target_checksum, &move) || move.motor < 0 || (size_t)move.motor >= motors.size()) {
+        return rate_mm_s;
+    }
+
+    extrusion.motor= move.motor;
+    extrusion.start= motors[move.motor]->last_milestone_mm;
+    extrusion.distance= move.distance;
+    return move.isecs > 0.0F ? rate_mm_s * move.rate : move.rate;
+}
+
 // Append a move to the queue ( cutting it into segments if needed )
 bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
 {
@@ -897,36 +1110,35 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
     // NOTE we need to do sqrt here as this setting of millimeters_of_travel is used by extruder and other modules even if there is no XYZ move
     gcode->millimeters_of_travel = sqrtf(powf( target[X_AXIS] - last_milestone[X_AXIS], 2 ) +  powf( target[Y_AXIS] - last_milestone[Y_AXIS], 2 ) +  powf( target[Z_AXIS] - last_milestone[Z_AXIS], 2 ));
 
-    // We ignore non- XYZ moves ( for example, extruder moves are not XYZ moves )
-    if( gcode->millimeters_of_travel < 0.00001F ) return false;
+    // the extruder works out its part of the move, a move of the extruder alone is one block
+    rate_mm_s= set_extrusion(gcode, rate_mm_s);
+    if( gcode->millimeters_of_travel < 0.00001F ) {
+        if(extrusion.motor < 0 || !is_valid_rate(gcode, rate_mm_s)) return false;
+        this->distance_in_gcode_is_known( gcode );
+        if(append_milestone(last_milestone, rate_mm_s)) THEKERNEL->conveyor->ensure_running();
+        extrusion.motor= -1;
+        return false;
+    }
 
     // Mark the gcode as having a known distance
     this->distance_in_gcode_is_known( gcode );
 
-    // if we have volumetric limits enabled we calculate the volume for this move and limit the rate if it exceeds the stated limit
-    // Note we need to be using volumetric extrusion for this to work as Ennn is in mm³ not mm
-    // We also check we are not exceeding the E max_speed for the current extruder
-    // We ask Extruder to do all the work, but as Extruder won't even see this gcode until after it has been planned
-    // we need to ask it now passing in the relevant data.
-    // NOTE we need to do this before we segment the line (for deltas)
-    if(gcode->has_letter('E')) {
-        float data[2];
-        data[0] = gcode->get_value('E'); // E target (may be absolute or relative)
-        data[1] = rate_mm_s / gcode->millimeters_of_travel; // inverted seconds for the move
-        if(PublicData::set_value(extruder_checksum, target_checksum, data)) {
-            rate_mm_s *= data[1];
-            //THEKERNEL->streams->printf("Extruder has changed the rate by %f to %f\n", data[1], rate_mm_s);
-        }
-    }
+    if(!is_valid_rate(gcode, rate_mm_s)) return false;
 
     // We cut the line into smaller segments. This is only needed on a cartesian robot for zgrid, but always necessary for robots with rotational axes like Deltas.
     // In delta robots either mm_per_line_segment can be used OR delta_segments_per_second
     // The latter is more efficient and avoids splitting fast long lines into very small segments, like initial z move to 0, it is what Johanns Marlin delta port does
     uint16_t segments;
+    bool adaptive= false;
 
     if(this->disable_segmentation || (!segment_z_moves && !gcode->has_letter('X') && !gcode->has_letter('Y'))) {
         segments= 1;
 
+    } else if(this->adaptive_segment_error > 0.0F) {
+        // the segments are found as they are queued, each as long as it can be without the actuators straying too far, see next_adaptive_segment()
+        segments= 0;
+        adaptive= true;
+
     } else if(this->delta_segments_per_second > 1.0F) {
         // enabled if set to something > 1, it is set to 0.0 by default
         // segment based on current speed and requested segments per second
@@ -944,42 +1156,224 @@ bool Robot::append_line(Gcode *gcode, const float target[], float rate_mm_s )
         }
     }
 
-    bool moved= false;
-    if (segments > 1) {
-        // A vector to keep track of the endpoint of each segment
-        float segment_delta[3];
-        float segment_end[3]{last_milestone[X_AXIS], last_milestone[Y_AXIS], last_milestone[Z_AXIS]};
-
-        // How far do we move each segment?
+    // segment 0 is already done - it's the end point of the previous move so we start at segment 1
+    // the last segment goes to the target, the others are each moved on by the same delta from the last
+    segmenter.arc= false;
+    segmenter.adaptive= adaptive;
+    segmenter.stream= gcode->stream;
+    segmenter.segments= segments;
+    segmenter.next= 1;
+    segmenter.batched= 0;
+    segmenter.batch_next= 0;
+    segmenter.rate_mm_s= rate_mm_s;
+    memcpy(segmenter.target, target, sizeof(segmenter.target));
+    memcpy(segmenter.position, last_milestone, sizeof(segmenter.position));
+    if(adaptive) {
+        segmenter.t= 0.0F;
+        segmenter.length= gcode->millimeters_of_travel;
         for (int i = X_AXIS; i <= Z_AXIS; i++)
-            segment_delta[i] = (target[i] - last_milestone[i]) / segments;
-
-        // segment 0 is already done - it's the end point of the previous move so we start at segment 1
-        // We always add another point after this loop so we stop at segments-1, ie i < segments
-        for (int i = 1; i < segments; i++) {
-            if(THEKERNEL->is_halted()) return false; // don't queue any more segments
-            for(int axis = X_AXIS; axis <= Z_AXIS; axis++ )
-                segment_end[axis] += segment_delta[axis];
-
-            // Append the end of this segment to the queue
-            bool b= this->append_milestone(gcode, segment_end, rate_mm_s);
-            moved= moved || b;
-        }
+            segmenter.delta[i] = target[i] - last_milestone[i];
+    } else {
+        for (int i = X_AXIS; i <= Z_AXIS; i++)
+            segmenter.delta[i] = (target[i] - last_milestone[i]) / segments;
     }
 
-    // Append the end of this full move to the queue
-    if(this->append_milestone(gcode, target, rate_mm_s)) moved= true;
+    // queue as many segments as fit now, the rest are queued by the conveyor as the queue empties
+    segmenter.busy= true;
+    if(append_segments()) {
+        // if adding these blocks didn't start executing, do that now
+        THEKERNEL->conveyor->ensure_running();
+    }
+    segmenter.busy= false;
 
     this->next_command_is_MCS = false; // always reset this
 
-    if(moved) {
-        // if adding these blocks didn't start executing, do that now
-        THEKERNEL->conveyor->ensure_running();
+    // last_milestone moves to the target even if the segments are not all queued yet
+    return true;
+}
+
+// Queue the segments of the current line or arc until the queue is full or they are all queued, returns true if any moved
+bool Robot::append_segments()
+{
+    bool moved= false;
+    while(segmenter.next > 0 && !THEKERNEL->conveyor->is_queue_full()) {
+        if(THEKERNEL->is_halted()) {
+            // don't queue any more segments
+            segmenter.next= 0;
+            break;
+        }
+
+        if(segmenter.adaptive) {
+            ActuatorCoordinates actuator_pos;
+            if(!next_adaptive_segment(actuator_pos)) {
+                // the rest of the line is one segment
+                segmenter.next= 0;
+                if(append_milestone(segmenter.target, segmenter.rate_mm_s, &actuator_pos)) moved= true;
+                break;
+            }
+
+            segmenter.next++;
+            if(append_milestone(segmenter.position, segmenter.rate_mm_s, &actuator_pos, segmenter.t)) moved= true;
+            continue;
+        }
+
+        if(segmenter.batch_next >= segmenter.batched) next_segment_batch();
+
+        // Append the end of this segment to the queue
+        const uint8_t i= segmenter.batch_next++;
+        if(append_milestone(segmenter.batch_ends[i], segmenter.rate_mm_s, &segmenter.batch_actuator_pos[i], segmenter.batch_fraction[i])) moved= true;
+
+        if(segmenter.batch_last && segmenter.batch_next >= segmenter.batched) {
+            segmenter.next= 0;
+            break;
+        }
     }
 
     return moved;
 }
 
+// Work out the ends of the next SEGMENT_BATCH segments, or upto the target, and convert them all to actuator positions in one
+// call, they are queued one at a time as room frees up in the queue
+void Robot::next_segment_batch()
+{
+    float transformed_ends[SEGMENT_BATCH][3];
+    uint8_t n= 0;
+    segmenter.batch_last= false;
+    while(n < SEGMENT_BATCH && !segmenter.batch_last) {
+        if(segmenter.next >= segmenter.segments) {
+            // Ensure last segment arrives at target location.
+            memcpy(segmenter.batch_ends[n], segmenter.target, sizeof(segmenter.batch_ends[n]));
+            segmenter.batch_fraction[n]= 1.0F;
+            segmenter.batch_last= true;
+        } else {
+            next_segment();
+            memcpy(segmenter.batch_ends[n], segmenter.position, sizeof(segmenter.batch_ends[n]));
+            segmenter.batch_fraction[n]= (float)(segmenter.next - 1) / segmenter.segments;
+        }
+
+        // the same transform append_milestone() applies
+        memcpy(transformed_ends[n], segmenter.batch_ends[n], sizeof(transformed_ends[n]));
+        if(compensationTransform) compensationTransform(transformed_ends[n]);
+        n++;
+    }
+
+    arm_solution->cartesian_to_actuators(transformed_ends, segmenter.batch_actuator_pos, n);
+    segmenter.batched= n;
+    segmenter.batch_next= 0;
+}
+
+// Move segmenter.position on to the end of the next segment of a line or arc
+void Robot::next_segment()
+{
+    if(segmenter.arc) {
+        if (segmenter.count < this->arc_correction ) {
+            // Apply vector rotation matrix
+            float r_axisi = segmenter.r[0] * segmenter.sin_T + segmenter.r[1] * segmenter.cos_T;
+            segmenter.r[0] = segmenter.r[0] * segmenter.cos_T - segmenter.r[1] * segmenter.sin_T;
+            segmenter.r[1] = r_axisi;
+            segmenter.count++;
+        } else {
+            // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments.
+            // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
+            float cos_Ti = cosf(segmenter.next * segmenter.theta_per_segment);
+            float sin_Ti = sinf(segmenter.next * segmenter.theta_per_segment);
+            segmenter.r[0] = -segmenter.offset[0] * cos_Ti + segmenter.offset[1] * sin_Ti;
+            segmenter.r[1] = -segmenter.offset[0] * sin_Ti - segmenter.offset[1] * cos_Ti;
+            segmenter.count = 0;
+        }
+
+        // Update arc_target location
+        segmenter.position[this->plane_axis_0] = segmenter.center[0] + segmenter.r[0];
+        segmenter.position[this->plane_axis_1] = segmenter.center[1] + segmenter.r[1];
+        segmenter.position[this->plane_axis_2] += segmenter.linear_per_segment;
+
+    } else {
+        for(int axis = X_AXIS; axis <= Z_AXIS; axis++ )
+            segmenter.position[axis] += segmenter.delta[axis];
+    }
+
+    segmenter.next++;
+}
+
+// Find the end of the next segment of a line split by adaptive_segment_error, and the actuator position there.
+// A segment is short enough when the actuator positions at its middle are within adaptive_segment_error of half way
+// between those at its ends. That error grows with the square of the length, so each try is sized from the error of the
+// last one. Returns false if the segment reaches the target.
+bool Robot::next_adaptive_segment(ActuatorCoordinates &actuator_pos)
+{
+    float remaining= 1.0F - segmenter.t;
+    float min_dt= ADAPTIVE_MIN_SEGMENT_MM / segmenter.length;
+    float dt= max(min_dt, min(remaining, segmenter.step / segmenter.length));
+    float end[3], mid[3];
+    ActuatorCoordinates mid_pos;
+
+    while(true) {
+        for (int i = X_AXIS; i <= Z_AXIS; i++) {
+            end[i]= dt >= remaining ? segmenter.target[i] : segmenter.position[i] + segmenter.delta[i] * dt;
+            mid[i]= segmenter.position[i] + segmenter.delta[i] * dt * 0.5F;
+        }
+        // the same transform append_milestone() will apply
+        if(compensationTransform) {
+            compensationTransform(end);
+            compensationTransform(mid);
+        }
+        arm_solution->cartesian_to_actuator(end, actuator_pos);
+        if(dt <= min_dt) break;
+
+        arm_solution->cartesian_to_actuator(mid, mid_pos);
+        float error= 0.0F;
+        for (size_t a = 0; a < actuators.size(); a++) {
+            error= max(error, fabsf(mid_pos[a] - 0.5F * (actuators[a]->last_milestone_mm + actuator_pos[a])));
+        }
+
+        // aim for 80% of the error allowed, growing by at most 4 times
+        float scale= error > 0.0F ? min(4.0F, 0.9F * sqrtf(this->adaptive_segment_error / error)) : 4.0F;
+        if(error <= this->adaptive_segment_error) {
+            segmenter.step= dt * segmenter.length * scale;
+            break;
+        }
+
+        dt= max(min_dt, dt * max(0.25F, scale));
+    }
+
+    if(dt >= remaining) return false;
+
+    segmenter.t += dt;
+    for (int i = X_AXIS; i <= Z_AXIS; i++)
+        segmenter.position[i] += segmenter.delta[i] * dt;
+    return true;
+}
+
+// Queue the segments still to do of the last line or arc, if wait is set this waits for room in the queue until they are all queued
+// This is called as the queue empties and before anything that has to come after them is done
+void Robot::queue_pending_segments(bool wait)
+{
+    if(segmenter.next == 0 || segmenter.busy) return;
+
+    segmenter.busy= true;
+    append_segments();
+    while(wait && segmenter.next > 0) {
+        THEKERNEL->conveyor->ensure_running();
+        THEKERNEL->call_event(ON_IDLE, this);
+        append_segments();
+    }
+    segmenter.busy= false;
+}
+
+// Called by the kernel before each line is sent to the modules. Anything but a query may change how moves are made or where
+// they go or has to happen after them, eg a move, M900, the ZProbe leveling commands or a T tool change, so it waits for the
+// rest of the last line or arc to be queued. Queries are answered while it is still being cut up
+void Robot::queue_pending_segments_before(const Gcode *gcode)
+{
+    if(segmenter.next == 0) return;
+    if(gcode->has_m) {
+        switch(gcode->m) {
+            case 27: case 105: case 112: case 114: case 115: case 119:
+                return;
+        }
+    }
+    queue_pending_segments(true);
+}
 
 // Append an arc to the queue ( cutting it into segments as needed )
 bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[], float radius, bool is_clockwise )
@@ -1014,8 +1408,22 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
     // Mark the gcode as having a known distance
     this->distance_in_gcode_is_known( gcode );
 
+    float rate_mm_s= set_extrusion(gcode, this->feed_rate / seconds_per_minute);
+    if(!is_valid_rate(gcode, rate_mm_s)) return false;
+
     // Figure out how many segments for this gcode
-    uint16_t segments = floorf(gcode->millimeters_of_travel / this->mm_per_arc_segment);
+    uint16_t segments;
+    if(this->mm_max_arc_error > 0.0F) {
+        // the longest chord that is no further than mm_max_arc_error from the arc, so big arcs get long segments and small ones short segments
+        float mm_per_segment = radius > this->mm_max_arc_error ? 2.0F * sqrtf(this->mm_max_arc_error * (2.0F * radius - this->mm_max_arc_error)) : 2.0F * radius;
+        if(this->mm_max_arc_segment > 0.0F && mm_per_segment > this->mm_max_arc_segment) mm_per_segment = this->mm_max_arc_segment;
+        if(mm_per_segment < this->mm_min_arc_segment) mm_per_segment = this->mm_min_arc_segment;
+        // travel includes any helical move, so helixes get slightly more segments than they need
+        segments = mm_per_segment > 0.0F ? min(65535.0F, ceilf(gcode->millimeters_of_travel / mm_per_segment)) : 1;
+
+    } else {
+        segments = floorf(gcode->millimeters_of_travel / this->mm_per_arc_segment);
+    }
 
     float theta_per_segment = angular_travel / segments;
     float linear_per_segment = linear_travel / segments;
@@ -1047,50 +1455,35 @@ bool Robot::append_arc(Gcode * gcode, const float target[], const float offset[]
     float cos_T = 1 - 0.5F * theta_per_segment * theta_per_segment; // Small angle approximation
     float sin_T = theta_per_segment;
 
-    float arc_target[3];
-    float sin_Ti;
-    float cos_Ti;
-    float r_axisi;
-    uint16_t i;
-    int8_t count = 0;
-
     // Initialize the linear axis
-    arc_target[this->plane_axis_2] = this->last_milestone[this->plane_axis_2];
+    segmenter.arc= true;
+    segmenter.adaptive= false;
+    segmenter.stream= gcode->stream;
+    segmenter.segments= segments;
+    segmenter.next= 1;
+    segmenter.batched= 0;
+    segmenter.batch_next= 0;
+    segmenter.count= 0;
+    segmenter.rate_mm_s= rate_mm_s;
+    segmenter.sin_T= sin_T;
+    segmenter.cos_T= cos_T;
+    segmenter.theta_per_segment= theta_per_segment;
+    segmenter.linear_per_segment= linear_per_segment;
+    segmenter.center[0]= center_axis0;
+    segmenter.center[1]= center_axis1;
+    segmenter.r[0]= r_axis0;
+    segmenter.r[1]= r_axis1;
+    segmenter.offset[0]= offset[this->plane_axis_0];
+    segmenter.offset[1]= offset[this->plane_axis_1];
+    memcpy(segmenter.target, target, sizeof(segmenter.target));
+    segmenter.position[this->plane_axis_2] = this->last_milestone[this->plane_axis_2];
+
+    // queue as many segments as fit now, the rest are queued by the conveyor as the queue empties
+    segmenter.busy= true;
+    append_segments();
+    segmenter.busy= false;
 
-    bool moved= false;
-    for (i = 1; i < segments; i++) { // Increment (segments-1)
-        if(THEKERNEL->is_halted()) return false; // don't queue any more segments
-
-        if (count < this->arc_correction ) {
-            // Apply vector rotation matrix
-            r_axisi = r_axis0 * sin_T + r_axis1 * cos_T;
-            r_axis0 = r_axis0 * cos_T - r_axis1 * sin_T;
-            r_axis1 = r_axisi;
-            count++;
-        } else {
-            // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments.
-            // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
-            cos_Ti = cosf(i * theta_per_segment);
-            sin_Ti = sinf(i * theta_per_segment);
-            r_axis0 = -offset[this->plane_axis_0] * cos_Ti + offset[this->plane_axis_1] * sin_Ti;
-            r_axis1 = -offset[this->plane_axis_0] * sin_Ti - offset[this->plane_axis_1] * cos_Ti;
-            count = 0;
-        }
-
-        // Update arc_target location
-        arc_target[this->plane_axis_0] = center_axis0 + r_axis0;
-        arc_target[this->plane_axis_1] = center_axis1 + r_axis1;
-        arc_target[this->plane_axis_2] += linear_per_segment;
-
-        // Append this segment to the queue
-        bool b= this->append_milestone(gcode, arc_target, this->feed_rate / seconds_per_minute);
-        moved= moved || b;
-    }
-
-    // Ensure last segment arrives at target location.
-    if(this->append_milestone(gcode, target, this->feed_rate / seconds_per_minute)) moved= true;
-
-    return moved;
+    return true;
 }
 
 // Do the math for an arc and add it to the queue
@@ -20,10 +20,15 @@ using std::string;
 class Gcode;
 class BaseSolution;
 class StepperMotor;
+class StreamOutput;
+struct RasterLine;
 
 // 9 WCS offsets
 #define MAX_WCS 9UL
 
+// segment ends converted to actuator positions in one call
+#define SEGMENT_BATCH 8
+
 class Robot : public Module {
     public:
         using wcs_t= std::tuple<float, float, float>;
@@ -42,6 +47,8 @@ class Robot : public Module {
         void  push_state();
         void  pop_state();
         void check_max_actuator_speeds();
+        int register_motor(StepperMotor *motor);
+        bool append_motor_move(int motor, float distance, float rate_mm_s);
         float to_millimeters( float value ) const { return this->inch_mode ? value * 25.4F : value; }
         float from_millimeters( float value) const { return this->inch_mode ? value/25.4F : value;  }
         void get_axis_position(float position[]) const { memcpy(position, this->last_milestone, sizeof this->last_milestone); }
@@ -52,11 +59,22 @@ class Robot : public Module {
         std::tuple<float, float, float, uint8_t> get_last_probe_position() const { return last_probe_position; }
         void set_last_probe_position(std::tuple<float, float, float, uint8_t> p) { last_probe_position = p; }
 
+        // lines and arcs are cut into segments as room frees up in the queue, these queue the ones still to do
+        // a stream should hold back its next line while the segments of its last move are still pending
+        bool has_pending_segments() const { return segmenter.next > 0; }
+        bool has_pending_segments(StreamOutput *stream) const { return segmenter.next > 0 && segmenter.stream == stream; }
+        void queue_pending_segments(bool wait);
+        void queue_pending_segments_before(const Gcode *gcode);
+        void discard_pending_segments() { segmenter.next= 0; }
+
         BaseSolution* arm_solution;                           // Selected Arm solution ( millimeters to step calculation )
 
         // gets accessed by Panel, Endstops, ZProbe
         std::array<StepperMotor*, k_max_actuators> actuators;
 
+        // every motor the planner moves, the actuators then the extruders, their index is the one in Block::steps
+        std::vector<StepperMotor*> motors;
+
         // set by a leveling strategy to transform the target of a move according to the current plan
         std::function<void(float[3])> compensationTransform;
 
@@ -78,11 +96,17 @@ class Robot : public Module {
     private:
         void load_config();
         void distance_in_gcode_is_known(Gcode* gcode);
-        bool append_milestone( Gcode *gcode, const float target[], float rate_mm_s);
+        bool append_milestone(const float target[], float rate_mm_s, const ActuatorCoordinates *target_actuator_pos= nullptr, float fraction= 1.0F);
+        float set_extrusion(Gcode *gcode, float rate_mm_s);
         bool append_line( Gcode* gcode, const float target[], float rate_mm_s);
+        bool append_segments();
+        bool next_adaptive_segment(ActuatorCoordinates &actuator_pos);
+        void next_segment();
+        void next_segment_batch();
         bool append_arc( Gcode* gcode, const float target[], const float offset[], float radius, bool is_clockwise );
         bool compute_arc(Gcode* gcode, const float offset[], const float target[]);
         void process_move(Gcode *gcode);
+        bool set_raster(Gcode *gcode);
 
         float theta(float x, float y);
         void select_plane(uint8_t axis_0, uint8_t axis_1, uint8_t axis_2);
@@ -101,13 +125,65 @@ class Robot : public Module {
         float last_milestone[3]; // Last requested position, in millimeters, which is what we were requested to move to in the gcode after offsets applied but before compensation transform
         float last_machine_position[3]; // Last machine position, which is the position before converting to actuator coordinates (includes compensation transform)
         int8_t motion_mode;                                  // Motion mode for the current received Gcode
+        bool is_g123;                                        // the move being queued is a G1, G2 or G3, given to each block for the laser
+        float s_value;                                       // S of the last move that had one, given to each block for the laser, -1 until then
+
+        // the pixels of the G7 being queued, each block gets the ones it moves over, found from how far along the line it ends
+        struct {
+            RasterLine *line;                                 // nullptr if the move is not a G7
+            float start[3];
+            float length;
+            uint16_t next_pixel;                              // first pixel of the next block
+        } raster;
+
         float seek_rate;                                     // Current rate for seeking moves ( mm/s )
         float feed_rate;                                     // Current rate for feeding moves ( mm/s )
         float mm_per_line_segment;                           // Setting : Used to split lines into segments
         float mm_per_arc_segment;                            // Setting : Used to split arcs into segments
+        float mm_max_arc_error;                              // Setting : If set arcs are split into the longest segments that stay this close to the arc
+        float mm_min_arc_segment;                            // Setting : Shortest and longest segments allowed when mm_max_arc_error is set, 0 for no limit
+        float mm_max_arc_segment;
         float delta_segments_per_second;                     // Setting : Used to split lines into segments for delta based on speed
+        float adaptive_segment_error;                        // Setting : If set lines are split only where the actuators would stray this far from moving linearly
         float seconds_per_minute;                            // for realtime speed change
 
+        // the extruder motor moving with the move being queued, each block of it takes the motor the same fraction of the way
+        // as it takes the arm, see set_extrusion()
+        struct {
+            int8_t motor;                                     // index in motors, -1 if no extruder moves
+            float start;                                      // where the motor was at the start of the move, in mm
+            float distance;                                   // and how far it moves over the whole move
+        } extrusion;
+
+        // the line or arc being cut into segments, the segments are generated as they fit in the queue
+        struct {
+            float target[3];                                  // end of the move, where the last segment goes
+            float position[3];                                // end of the last segment queued
+            float delta[3];                                   // how far each segment of a line moves, the whole line if adaptive
+            float t, length;                                  // adaptive: fraction of the line done, and its length
+            float step;                                       // adaptive: length of the next segment to try, carried over to the next line
+            float center[2];                                  // arc center in the plane
+            float r[2];                                       // radius vector from the center to position
+            float offset[2];                                  // initial radius vector is -offset, used for arc correction
+            float sin_T, cos_T;                               // rotation of the radius vector per segment
+            float theta_per_segment;
+            float linear_per_segment;
+            float rate_mm_s;
+            StreamOutput *stream;                             // stream the move came from
+            float batch_ends[SEGMENT_BATCH][3];               // segment ends worked out ahead of the queue, and their actuator positions
+            ActuatorCoordinates batch_actuator_pos[SEGMENT_BATCH];
+            float batch_fraction[SEGMENT_BATCH];              // and the fraction of the move done at each
+            uint8_t batched;                                  // number of segment ends in the batch
+            uint8_t batch_next;                               // next one of them to queue
+            uint16_t segments;
+            uint16_t next;                                    // next segment to queue, 0 if there is nothing pending
+            int8_t count;                                     // segments since the last arc correction
+            bool arc:1;
+            bool adaptive:1;                                  // line split by adaptive_segment_error, the number of segments is not known up front
+            bool busy:1;                                      // set while queueing so ON_IDLE does not reenter
+            bool batch_last:1;                                // the batch ends at the target
+        } segmenter;
+
         // Number of arc generation iterations by small angle approximation before exact arc trajectory
         // correction. This parameter may be decreased if there are issues with the accuracy of the arc
         // generations. In general, the default value is more than enough for the intended CNC applications
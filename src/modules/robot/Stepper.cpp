@@ -28,15 +28,29 @@ using namespace std;
 #include "libs/Hook.h"
 
 #include <mri.h>
+#include <math.h>
+
+#define prepare_step_segments_checksum CHECKSUM("prepare_step_segments")
 
 // The stepper reacts to blocks that have XYZ movement to transform them into actual stepper motor moves
+// It steps all of Robot's motors, the actuators and the extruders registered with it, so an extrusion is a block like any other
 // TODO: This does accel, accel should be in StepperMotor
+// The step rates for each acceleration tick of the current block are normally prepared in the main loop as segments, so all
+// the acceleration tick has to do is copy them to the motors, if the main loop has not kept up it works them out itself
+// When the block has a jerk the acceleration and deceleration follow an S-curve instead of changing the rate by the same each tick
 
 Stepper::Stepper()
 {
     this->current_block = NULL;
     this->force_speed_update = false;
     this->halted= false;
+    this->block_sequence= 0;
+    this->segment_underruns= 0;
+    this->resync_segments= false;
+    this->prepared.sequence= 0;
+    this->prepared.complete= false;
+    this->phase= ACCELERATING;
+    this->phase_ticks= 0;
 }
 
 //Called when the module has just been loaded
@@ -45,8 +59,11 @@ void Stepper::on_module_loaded()
     this->register_for_event(ON_BLOCK_BEGIN);
     this->register_for_event(ON_BLOCK_END);
     this->register_for_event(ON_GCODE_EXECUTE);
-    this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', 17);
+    this->register_for_gcode('M', 18);
+    this->register_for_gcode('M', 84);
     this->register_for_event(ON_HALT);
+    this->register_for_event(ON_IDLE);
 
     // Get onfiguration
     this->on_config_reload(this);
@@ -64,6 +81,8 @@ void Stepper::on_config_reload(void *argument)
 {
     // Steppers start off by default
     this->turn_enable_pins_off();
+
+    this->prepare_step_segments = THEKERNEL->config->value(prepare_step_segments_checksum)->by_default(true)->as_bool();
 }
 
 void Stepper::on_halt(void *argument)
@@ -123,10 +142,10 @@ void Stepper::on_block_begin(void *argument)
 {
     Block *block  = static_cast<Block *>(argument);
 
-    // Mark the new block as of interrest to us, handle blocks that have no axis moves properly (like Extrude blocks etc)
+    // Mark the new block as of interrest to us, handle blocks that have no moves properly
     bool take = false;
     if (block->millimeters > 0.0F) {
-        for (size_t s = 0; !take && s < THEKERNEL->robot->actuators.size(); s++) {
+        for (size_t s = 0; !take && s < THEKERNEL->robot->motors.size(); s++) {
             take = block->steps[s] > 0;
         }
     }
@@ -134,7 +153,7 @@ void Stepper::on_block_begin(void *argument)
         block->take();
     } else {
         // none of the steppers move this block so make sure they know that
-        for(auto a : THEKERNEL->robot->actuators) {
+        for(auto a : THEKERNEL->robot->motors) {
             a->set_moved_last_block(false);
         }
         return;
@@ -145,25 +164,38 @@ void Stepper::on_block_begin(void *argument)
         this->turn_enable_pins_on();
     }
 
+    // slow blocks have the base tick divided so the steps of the slower actuators are placed more finely, as the tick gets
+    // shorter the interrupt runs more often, so a level is only used while the fastest actuator takes more than 2^level base ticks per step
+    uint8_t amass_level= 0;
+    while(amass_level < THEKERNEL->step_ticker->get_amass_max_level() && block->nominal_rate * (2 << amass_level) < THEKERNEL->step_ticker->get_frequency()) {
+        amass_level++;
+    }
+    THEKERNEL->step_ticker->set_amass_level(amass_level);
+
     // Setup : instruct stepper motors to move
     // Find the stepper with the more steps, it's the one the speed calculations will want to follow
     this->main_stepper = nullptr;
     int most_steps_to_move = 0;
-    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
+    for (size_t i = 0; i < THEKERNEL->robot->motors.size(); i++) {
         if (block->steps[i] > 0) {
-            THEKERNEL->robot->actuators[i]->move(block->direction_bits[i], block->steps[i])->set_moved_last_block(true);
-            int steps_to_move = THEKERNEL->robot->actuators[i]->get_steps_to_move();
+            THEKERNEL->robot->motors[i]->move((block->direction_bits >> i) & 1, block->steps[i])->set_moved_last_block(true);
+            int steps_to_move = THEKERNEL->robot->motors[i]->get_steps_to_move();
             if (steps_to_move > most_steps_to_move) {
                 most_steps_to_move = steps_to_move;
-                this->main_stepper = THEKERNEL->robot->actuators[i];
+                this->main_stepper = THEKERNEL->robot->motors[i];
             }
         }
         else {
-            THEKERNEL->robot->actuators[i]->set_moved_last_block(false);
+            THEKERNEL->robot->motors[i]->set_moved_last_block(false);
         }
     }
 
     this->current_block = block;
+    this->rate_delta = block->get_rate_delta();
+
+    // any segments left are for the last block, and prepare_segments() will start on this one
+    this->segments.tail= this->segments.head;
+    this->block_sequence++;
 
     // Setup acceleration for this block
     this->trapezoid_generator_reset();
@@ -190,8 +222,8 @@ void Stepper::on_block_end(void *argument)
 uint32_t Stepper::stepper_motor_finished_move(uint32_t dummy)
 {
     // We care only if none is still moving
-    for (auto a : THEKERNEL->robot->actuators) {
-        if(a->moving)    
+    for (auto a : THEKERNEL->robot->motors) {
+        if(a->moving)
             return 0;
     }
 
@@ -224,51 +256,256 @@ void Stepper::trapezoid_generator_tick(void)
 
         } else if(THEKERNEL->conveyor->is_flushing()) {
             // if we are flushing the queue, decelerate to 0 then finish this block
-            if (trapezoid_adjusted_rate > current_block->rate_delta * 1.5F) {
-                trapezoid_adjusted_rate -= current_block->rate_delta;
+            if (trapezoid_adjusted_rate > this->rate_delta * 1.5F) {
+                trapezoid_adjusted_rate -= this->rate_delta;
 
-            } else if (trapezoid_adjusted_rate == current_block->rate_delta * 0.5F) {
-                for (auto i : THEKERNEL->robot->actuators) i->move(i->direction, 0); // stop motors
+            } else if (trapezoid_adjusted_rate == this->rate_delta * 0.5F) {
+                for (auto i : THEKERNEL->robot->motors) i->move(i->direction, 0); // stop motors
                 if (current_block) current_block->release();
                 THEKERNEL->call_event(ON_SPEED_CHANGE, 0); // tell others we stopped
                 return;
 
             } else {
-                trapezoid_adjusted_rate = current_block->rate_delta * 0.5F;
+                trapezoid_adjusted_rate = this->rate_delta * 0.5F;
+            }
+
+        } else {
+            // count the ticks the block has been in this phase, the S-curve is worked out from them
+            uint8_t phase= trapezoid_phase(this->current_block, current_steps_completed);
+            if(phase != this->phase) {
+                this->phase= phase;
+                this->phase_ticks= 0;
+            }
+            this->phase_ticks++;
+
+            if(this->prepare_step_segments && apply_segment(phase)) {
+                // the speeds had been prepared, and have been set
+                return;
             }
+            this->trapezoid_adjusted_rate= trapezoid_rate(this->current_block, this->trapezoid_adjusted_rate, phase, this->phase_ticks);
+        }
+
+        if(last_rate != trapezoid_adjusted_rate) {
+            // don't call this if speed did not change
+            this->set_step_events_per_second(this->trapezoid_adjusted_rate);
+        }
+    }
+}
 
-        } else if(current_steps_completed <= this->current_block->accelerate_until) {
-            // If we are accelerating
+// Which part of the trapezoid the block is in when the main stepper has completed the given steps
+uint8_t Stepper::trapezoid_phase(const Block *block, uint32_t steps_completed)
+{
+    if(steps_completed <= block->accelerate_until) return ACCELERATING;
+    if(steps_completed > block->decelerate_after) return DECELERATING;
+    return CRUISING;
+}
+
+// The rate for the next acceleration tick of the block given the current rate, the phase the main stepper is in and the number
+// of acceleration ticks it has been in it including this one
+float Stepper::trapezoid_rate(const Block *block, float rate, uint8_t phase, uint32_t phase_ticks) const
+{
+    if(block->s_curve_ramp > 0 && phase != CRUISING) {
+        return s_curve_rate(this->s_curve[phase == ACCELERATING ? 0 : 1], phase_ticks);
+    }
+
+    switch(phase) {
+        case ACCELERATING:
             // Increase speed
-            this->trapezoid_adjusted_rate += this->current_block->rate_delta;
-            if (this->trapezoid_adjusted_rate > this->current_block->nominal_rate ) {
-                this->trapezoid_adjusted_rate = this->current_block->nominal_rate;
+            rate += this->rate_delta;
+            if (rate > block->nominal_rate ) {
+                rate = block->nominal_rate;
             }
+            break;
 
-        } else if (current_steps_completed > this->current_block->decelerate_after) {
-            // If we are decelerating
+        case DECELERATING:
             // Reduce speed
             // NOTE: We will only reduce speed if the result will be > 0. This catches small
             // rounding errors that might leave steps hanging after the last trapezoid tick.
-            if(this->trapezoid_adjusted_rate > this->current_block->rate_delta * 1.5F) {
-                this->trapezoid_adjusted_rate -= this->current_block->rate_delta;
+            if(rate > this->rate_delta * 1.5F) {
+                rate -= this->rate_delta;
             } else {
-                this->trapezoid_adjusted_rate = this->current_block->rate_delta * 1.5F;
+                rate = this->rate_delta * 1.5F;
             }
-            if(this->trapezoid_adjusted_rate < this->current_block->final_rate ) {
-                this->trapezoid_adjusted_rate = this->current_block->final_rate;
+            if(rate < block->final_rate ) {
+                rate = block->final_rate;
             }
+            break;
 
-        } else if (trapezoid_adjusted_rate != current_block->nominal_rate) {
-            // If we are cruising
+        case CRUISING:
             // Make sure we cruise at exactly nominal rate
-            this->trapezoid_adjusted_rate = this->current_block->nominal_rate;
+            rate = block->nominal_rate;
+            break;
+    }
+    return rate;
+}
+
+// Work out the S-curves for the acceleration and deceleration of the current block when it is jerk limited, they go between the
+// same rates as the constant acceleration would, the deceleration from the rate it would reach at accelerate_until
+void Stepper::s_curve_reset()
+{
+    const Block *block= this->current_block;
+    if(block->s_curve_ramp == 0) return;
+
+    float peak= sqrtf((float)block->initial_rate * block->initial_rate + 2.0F * this->rate_delta * THEKERNEL->acceleration_ticks_per_second * block->accelerate_until);
+    if(peak > block->nominal_rate) peak= block->nominal_rate;
+    set_s_curve(this->s_curve[0], block->initial_rate, peak);
+    set_s_curve(this->s_curve[1], peak, max((float)block->final_rate, this->rate_delta * 1.5F));
+}
+
+void Stepper::set_s_curve(SCurve &curve, float from, float to) const
+{
+    curve.start_rate= from;
+    curve.delta= to - from;
+    curve.ticks= fabsf(curve.delta) / this->rate_delta;
+
+    // the acceleration ramps for r of the time at each end, so to change the rate by the same amount in the same time it has to peak
+    // at 1/(1-r) times the constant acceleration of the block, the planner lowered that by as much so the peak is what was configured
+    curve.ramp= this->current_block->s_curve_ramp / 256.0F;
+}
+
+// The rate after the given number of acceleration ticks along an S-curve, the acceleration ramps up, holds and then ramps down, and
+// as it is symmetrical the distance moved is the same as at constant acceleration, so the planned steps for each phase still hold
+float Stepper::s_curve_rate(const SCurve &curve, uint32_t ticks)
+{
+    if(ticks >= curve.ticks) return curve.start_rate + curve.delta;
+
+    float s= ticks / curve.ticks;       // how far through it is
+    float r= curve.ramp;
+    float peak= 1.0F / (1.0F - r);      // the peak acceleration relative to the constant one
+    float f;                            // the fraction of the change done
+    if(s < r) {
+        f= peak * s * s / (2.0F * r);
+    } else if(s <= 1.0F - r) {
+        f= peak * (s - r / 2.0F);
+    } else {
+        float e= 1.0F - s;
+        f= 1.0F - peak * e * e / (2.0F * r);
+    }
+    return curve.start_rate + curve.delta * f;
+}
+
+// Called in the acceleration tick, set the motor speeds from the next prepared segment
+// returns false if there was none ready and the caller has to work out the rate
+bool Stepper::apply_segment(uint8_t phase)
+{
+    while(this->segments.tail != this->segments.head) {
+        StepSegment *segment= this->segments.get_tail_ref();
+        if(segment->phase < phase) {
+            // the main stepper has got further than was predicted, skip the rest of that phase
+            this->segments.delete_tail();
+            continue;
+        }
+        if(segment->phase > phase) {
+            // the main stepper has not got as far as was predicted, stay at this rate until it does
+            return true;
+        }
+        bool last= this->prepared.complete && this->prepared.sequence == this->block_sequence && this->segments.next_block_index(this->segments.tail) == this->segments.head;
+        if(!last && ((phase == ACCELERATING && segment->rate <= this->trapezoid_adjusted_rate) || (phase == DECELERATING && segment->rate >= this->trapezoid_adjusted_rate))) {
+            // the last phase did not end where it was predicted, so the rate is already past this one, the rate only ever
+            // moves on to the next one in the direction of the phase so it never changes by more than rate_delta a tick
+            this->segments.delete_tail();
+            continue;
         }
 
-        if(last_rate != trapezoid_adjusted_rate) {
-            // don't call this if speed did not change
-            this->set_step_events_per_second(this->trapezoid_adjusted_rate);
+        // a cruise segment stays until the deceleration starts
+        if(segment->phase != CRUISING) this->segments.delete_tail();
+
+        if(segment->rate != this->trapezoid_adjusted_rate) {
+            this->trapezoid_adjusted_rate= segment->rate;
+            for (size_t i = 0; i < THEKERNEL->robot->motors.size(); i++) {
+                if (THEKERNEL->robot->motors[i]->moving) {
+                    THEKERNEL->robot->motors[i]->set_fx_ticks_per_step(segment->fx_ticks_per_step[i]);
+                }
+            }
+
+            // Other modules might want to know the speed changed
+            THEKERNEL->call_event(ON_SPEED_CHANGE, this);
+        }
+        return true;
+    }
+
+    // nothing left, which is fine if the last segment was for the end of the block
+    if(this->prepared.complete && this->prepared.sequence == this->block_sequence) return true;
+
+    this->segment_underruns++;
+    this->resync_segments= true;
+    return false;
+}
+
+void Stepper::on_idle(void *argument)
+{
+    if(this->prepare_step_segments) prepare_segments();
+}
+
+// Fill the segment queue with the rates the acceleration tick will need for the current block, called from the main loop
+// so the floating point math is not done in the interrupt. This predicts how far the main stepper will have got at each tick,
+// apply_segment() checks that against where it really is
+void Stepper::prepare_segments()
+{
+    while(true) {
+        __disable_irq();
+        if(this->current_block == nullptr || this->main_stepper == nullptr) {
+            __enable_irq();
+            return;
+        }
+        if(this->prepared.sequence != this->block_sequence || this->resync_segments) {
+            // a new block has begun or the acceleration tick ran out of segments, start from where it is now
+            this->segments.tail= this->segments.head;
+            this->resync_segments= false;
+            this->prepared.sequence= this->block_sequence;
+            this->prepared.rate= this->trapezoid_adjusted_rate;
+            this->prepared.steps= this->main_stepper->stepped + this->trapezoid_adjusted_rate / THEKERNEL->acceleration_ticks_per_second;
+            this->prepared.phase= this->phase;
+            this->prepared.phase_ticks= this->phase_ticks;
+            this->prepared.complete= false;
+        }
+        // a block begin can happen in an interrupt while we work, so work on a copy and only keep it if it is still current
+        const Block *block= this->current_block;
+        auto next= this->prepared;
+        bool full= this->segments.next_block_index(this->segments.head) == this->segments.tail;
+        __enable_irq();
+
+        if(next.complete || full) return;
+
+        StepSegment segment;
+        uint32_t steps= next.steps;
+        segment.phase= trapezoid_phase(block, steps);
+        if(segment.phase != next.phase) {
+            next.phase= segment.phase;
+            next.phase_ticks= 0;
+        }
+        next.phase_ticks++;
+        segment.rate= trapezoid_rate(block, next.rate, segment.phase, next.phase_ticks);
+
+        bool changed= segment.rate != next.rate;
+        next.rate= segment.rate;
+        next.steps += segment.rate / THEKERNEL->acceleration_ticks_per_second;
+        if(segment.phase == CRUISING) {
+            // one segment holds the cruise, the next is the first deceleration tick
+            next.steps= block->decelerate_after + 1;
+        }
+        if((segment.phase == DECELERATING && !changed) || segment.rate <= 0.0F) {
+            // reached the final rate, the acceleration tick will stay at it until the block ends
+            next.complete= true;
+        }
+
+        if(changed || segment.phase == CRUISING || next.complete) {
+            float isps= segment.rate / block->steps_event_count;
+            for (size_t i = 0; i < THEKERNEL->robot->motors.size(); i++) {
+                segment.fx_ticks_per_step[i]= THEKERNEL->robot->motors[i]->fx_ticks_for_speed(isps * block->steps[i]);
+            }
+        }
+
+        __disable_irq();
+        if(next.sequence == this->block_sequence && !this->resync_segments) {
+            // an acceleration tick where the rate does not change needs no segment
+            if(changed || segment.phase == CRUISING || next.complete) {
+                *this->segments.get_head_ref()= segment;
+                this->segments.head= this->segments.next_block_index(this->segments.head);
+            }
+            this->prepared= next;
         }
+        __enable_irq();
     }
 }
 
@@ -278,6 +515,9 @@ inline void Stepper::trapezoid_generator_reset()
 {
     this->trapezoid_adjusted_rate = this->current_block->initial_rate;
     this->force_speed_update = true;
+    this->phase= ACCELERATING;
+    this->phase_ticks= 0;
+    s_curve_reset();
 }
 
 // Update the speed for all steppers
@@ -286,9 +526,9 @@ void Stepper::set_step_events_per_second( float steps_per_second )
     float isps= steps_per_second / this->current_block->steps_event_count;
 
     // Instruct the stepper motors
-    for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); i++) {
-        if (THEKERNEL->robot->actuators[i]->moving) {
-            THEKERNEL->robot->actuators[i]->set_speed(isps * this->current_block->steps[i]);
+    for (size_t i = 0; i < THEKERNEL->robot->motors.size(); i++) {
+        if (THEKERNEL->robot->motors[i]->moving) {
+            THEKERNEL->robot->motors[i]->set_speed(isps * this->current_block->steps[i]);
         }
     }
 
@@ -9,11 +9,20 @@
 #define STEPPER_H
 
 #include "libs/Module.h"
+#include "libs/RingBuffer.h"
+#include "ActuatorCoordinates.h"
 #include <stdint.h>
 
 class Block;
 class StepperMotor;
 
+// A piece of the current block at a constant step rate, prepared in the main loop so the acceleration tick only has to copy it
+struct StepSegment {
+    uint32_t fx_ticks_per_step[k_max_motors];    // for each motor, the value StepperMotor::set_speed() would have set
+    float rate;                                  // the trapezoid_adjusted_rate this was calculated from
+    uint8_t phase;                               // the trapezoid phase it is for
+};
+
 class Stepper : public Module
 {
 public:
@@ -25,6 +34,7 @@ public:
     void on_gcode_received(void *argument);
     void on_gcode_execute(void *argument);
     void on_halt(void *argument);
+    void on_idle(void *argument);
 
     void trapezoid_generator_reset();
     void set_step_events_per_second(float);
@@ -36,16 +46,58 @@ public:
 
     float get_trapezoid_adjusted_rate() const { return trapezoid_adjusted_rate; }
     const Block *get_current_block() const { return current_block; }
+    StepperMotor *get_main_stepper() const { return main_stepper; }
+    uint32_t get_segment_underruns() const { return segment_underruns; }
 
 private:
+    enum TRAPEZOID_PHASE { ACCELERATING, CRUISING, DECELERATING };
+    static uint8_t trapezoid_phase(const Block *block, uint32_t steps_completed);
+    float trapezoid_rate(const Block *block, float rate, uint8_t phase, uint32_t phase_ticks) const;
+    void prepare_segments();
+    bool apply_segment(uint8_t phase);
+
+    // a jerk limited change of rate, see s_curve_rate()
+    struct SCurve {
+        float start_rate;
+        float delta;                    // the change in rate
+        float ticks;                    // acceleration ticks it takes, the same as at constant acceleration
+        float ramp;                     // the fraction of it at each end where the acceleration ramps up or down
+    };
+    void s_curve_reset();
+    void set_s_curve(SCurve &curve, float from, float to) const;
+    static float s_curve_rate(const SCurve &curve, uint32_t ticks);
+
     Block *current_block;
     float trapezoid_adjusted_rate;
+    float rate_delta;                   // of the current block, the steps per second to change the rate by each acceleration tick
     StepperMotor *main_stepper;
 
+    // the acceleration and deceleration of the current block when it is jerk limited
+    SCurve s_curve[2];
+    uint8_t phase;                      // the trapezoid phase of the last acceleration tick
+    uint32_t phase_ticks;               // and the number of acceleration ticks the block has been in it
+
+    // segments of the current block prepared by the main loop, consumed by the acceleration tick
+    RingBuffer<StepSegment, 16> segments;
+    volatile uint32_t block_sequence;   // incremented by each block begin, segments are only queued for the latest one
+    uint32_t segment_underruns;         // acceleration ticks that found no prepared segment and worked out the rate themselves
+    volatile bool resync_segments;      // set by the acceleration tick after an underrun, start preparing again from where it is
+
+    // where prepare_segments() has got to in the current block
+    struct {
+        uint32_t sequence;
+        float rate;
+        float steps;                    // predicted steps completed by the main stepper
+        uint8_t phase;
+        uint32_t phase_ticks;
+        bool complete;                  // the rest of the block runs at the rate of the last segment
+    } prepared;
+
     struct {
         bool enable_pins_status:1;
         bool force_speed_update:1;
         bool halted:1;
+        bool prepare_step_segments:1;
     };
 
 };
@@ -13,6 +13,10 @@ class BaseSolution {
         BaseSolution(Config*){};
         virtual ~BaseSolution() {};
         virtual void cartesian_to_actuator(const float[], ActuatorCoordinates &) = 0;
+        // converts n points in one call, solutions with costly kinematics override this to work out their constants once
+        virtual void cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) {
+            for (size_t i = 0; i < n; i++) cartesian_to_actuator(cartesian_mm[i], actuator_mm[i]);
+        }
         virtual void actuator_to_cartesian(const ActuatorCoordinates &, float[]) = 0;
         typedef std::map<char, float> arm_options_t;
         virtual bool set_optional(const arm_options_t& options) { return false; };
@@ -55,23 +55,43 @@ void LinearDeltaSolution::init() {
     delta_tower3_y = (delta_radius + tower3_offset) * sinf((90.0F  + tower3_angle) * PIOVER180);
 }
 
-void LinearDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm )
-{
+// the tower positions, copied out of the solution so they stay in registers while converting a batch of points
+struct LinearDeltaTowers {
+    float arm_length_squared;
+    float x[3];
+    float y[3];
+};
 
-    actuator_mm[ALPHA_STEPPER] = sqrtf(this->arm_length_squared
-                                       - SQ(delta_tower1_x - cartesian_mm[X_AXIS])
-                                       - SQ(delta_tower1_y - cartesian_mm[Y_AXIS])
+static inline void linear_delta_ik(const LinearDeltaTowers &t, const float cartesian_mm[], ActuatorCoordinates &actuator_mm)
+{
+    actuator_mm[ALPHA_STEPPER] = sqrtf(t.arm_length_squared
+                                       - SQ(t.x[0] - cartesian_mm[X_AXIS])
+                                       - SQ(t.y[0] - cartesian_mm[Y_AXIS])
                                       ) + cartesian_mm[Z_AXIS];
-    actuator_mm[BETA_STEPPER ] = sqrtf(this->arm_length_squared
-                                       - SQ(delta_tower2_x - cartesian_mm[X_AXIS])
-                                       - SQ(delta_tower2_y - cartesian_mm[Y_AXIS])
+    actuator_mm[BETA_STEPPER ] = sqrtf(t.arm_length_squared
+                                       - SQ(t.x[1] - cartesian_mm[X_AXIS])
+                                       - SQ(t.y[1] - cartesian_mm[Y_AXIS])
                                       ) + cartesian_mm[Z_AXIS];
-    actuator_mm[GAMMA_STEPPER] = sqrtf(this->arm_length_squared
-                                       - SQ(delta_tower3_x - cartesian_mm[X_AXIS])
-                                       - SQ(delta_tower3_y - cartesian_mm[Y_AXIS])
+    actuator_mm[GAMMA_STEPPER] = sqrtf(t.arm_length_squared
+                                       - SQ(t.x[2] - cartesian_mm[X_AXIS])
+                                       - SQ(t.y[2] - cartesian_mm[Y_AXIS])
                                       ) + cartesian_mm[Z_AXIS];
 }
 
+void LinearDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm )
+{
+    const LinearDeltaTowers t{arm_length_squared, {delta_tower1_x, delta_tower2_x, delta_tower3_x}, {delta_tower1_y, delta_tower2_y, delta_tower3_y}};
+    linear_delta_ik(t, cartesian_mm, actuator_mm);
+}
+
+void LinearDeltaSolution::cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    const LinearDeltaTowers t{arm_length_squared, {delta_tower1_x, delta_tower2_x, delta_tower3_x}, {delta_tower1_y, delta_tower2_y, delta_tower3_y}};
+    for (size_t i = 0; i < n; i++) {
+        linear_delta_ik(t, cartesian_mm[i], actuator_mm[i]);
+    }
+}
+
 void LinearDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] )
 {
     // from http://en.wikipedia.org/wiki/Circumscribed_circle#Barycentric_coordinates_from_cross-_and_dot-products
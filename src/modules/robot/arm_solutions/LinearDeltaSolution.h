@@ -9,6 +9,7 @@ class LinearDeltaSolution : public BaseSolution {
     public:
         LinearDeltaSolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
 
         bool set_optional(const arm_options_t& options) override;
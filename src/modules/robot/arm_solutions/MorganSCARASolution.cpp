@@ -12,6 +12,7 @@
 //#include "StepperMotor.h"
 
 #include "libs/nuts_bolts.h"
+#include "libs/FastMath.h"
 
 #include "libs/Config.h"
 
@@ -24,6 +25,7 @@
 #define morgan_homing_checksum        CHECKSUM("morgan_homing")
 #define morgan_undefined_min_checksum CHECKSUM("morgan_undefined_min")
 #define morgan_undefined_max_checksum CHECKSUM("morgan_undefined_max")
+#define arm_fast_math_checksum        CHECKSUM("arm_fast_math")
 
 #define SQ(x) powf(x, 2)
 #define ROUND(x, y) (roundf(x * 1e ## y) / 1e ## y)
@@ -47,6 +49,8 @@ MorganSCARASolution::MorganSCARASolution(Config* config)
     morgan_undefined_min  = config->value(morgan_undefined_min_checksum)->by_default(0.95f)->as_number();
     // max: head on maximum reach
     morgan_undefined_max  = config->value(morgan_undefined_max_checksum)->by_default(0.95f)->as_number();
+    // use the approximations in FastMath.h instead of libm for the inverse kinematics
+    fast_math           = config->value(arm_fast_math_checksum)->by_default(false)->as_bool();
 
     init();
 }
@@ -59,7 +63,20 @@ float MorganSCARASolution::to_degrees(float radians) {
     return radians*(180.0F/3.14159265359f);
 }
 
-void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm )
+// the arm geometry as used by the inverse kinematics, worked out once per call or per batch of points
+struct MorganSCARAIK {
+    float offset_x, offset_y;
+    float scaling_x, scaling_y;
+    float c2_sub1, c2_sub2;     // subtracted from x^2 + y^2 to find cos(psi)
+    float c2_div;
+    float undefined_min, undefined_max;
+    float arm1_length, arm2_length;
+    bool fast_math;
+};
+
+static inline float ik_atan2f(const MorganSCARAIK &k, float y, float x) { return k.fast_math ? fast_atan2f(y, x) : atan2f(y, x); }
+
+static inline void morgan_scara_ik(const MorganSCARAIK &k, const float cartesian_mm[], ActuatorCoordinates &actuator_mm)
 {
 
     float SCARA_pos[2],
@@ -70,40 +87,73 @@ void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], Actu
           SCARA_theta,
           SCARA_psi;
 
-    SCARA_pos[X_AXIS] = (cartesian_mm[X_AXIS] - this->morgan_offset_x)  * this->morgan_scaling_x;  //Translate cartesian to tower centric SCARA X Y AND apply scaling factor from this offset.
-    SCARA_pos[Y_AXIS] = (cartesian_mm[Y_AXIS]  * this->morgan_scaling_y - this->morgan_offset_y);  // morgan_offset not to be confused with home offset. This makes the SCARA math work.
+    SCARA_pos[X_AXIS] = (cartesian_mm[X_AXIS] - k.offset_x)  * k.scaling_x;  //Translate cartesian to tower centric SCARA X Y AND apply scaling factor from this offset.
+    SCARA_pos[Y_AXIS] = (cartesian_mm[Y_AXIS]  * k.scaling_y - k.offset_y);  // morgan_offset not to be confused with home offset. This makes the SCARA math work.
     // Y has to be scaled before subtracting offset to ensure position on bed.
 
-    if (this->arm1_length == this->arm2_length)
-        SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-2.0f*SQ(this->arm1_length)) / (2.0f * SQ(this->arm1_length));
-    else
-        SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-SQ(this->arm1_length)-SQ(this->arm2_length)) / (2.0f * SQ(this->arm1_length));
+    SCARA_C2 = (SQ(SCARA_pos[X_AXIS])+SQ(SCARA_pos[Y_AXIS])-k.c2_sub1-k.c2_sub2) / k.c2_div;
 
     // SCARA position is undefined if abs(SCARA_C2) >=1
     // In reality abs(SCARA_C2) >0.95 can be problematic.
 
-    if (SCARA_C2 > this->morgan_undefined_max)
-        SCARA_C2 = this->morgan_undefined_max;
-    else if (SCARA_C2 < -this->morgan_undefined_min)
-        SCARA_C2 = -this->morgan_undefined_min;
+    if (SCARA_C2 > k.undefined_max)
+        SCARA_C2 = k.undefined_max;
+    else if (SCARA_C2 < -k.undefined_min)
+        SCARA_C2 = -k.undefined_min;
 
 
     SCARA_S2 = sqrtf(1.0f-SQ(SCARA_C2));
 
-    SCARA_K1 = this->arm1_length+this->arm2_length*SCARA_C2;
-    SCARA_K2 = this->arm2_length*SCARA_S2;
+    SCARA_K1 = k.arm1_length+k.arm2_length*SCARA_C2;
+    SCARA_K2 = k.arm2_length*SCARA_S2;
 
-    SCARA_theta = (atan2f(SCARA_pos[X_AXIS],SCARA_pos[Y_AXIS])-atan2f(SCARA_K1, SCARA_K2))*-1.0f;    // Morgan Thomas turns Theta in oposite direction
-    SCARA_psi   = atan2f(SCARA_S2,SCARA_C2);
+    SCARA_theta = (ik_atan2f(k, SCARA_pos[X_AXIS],SCARA_pos[Y_AXIS])-ik_atan2f(k, SCARA_K1, SCARA_K2))*-1.0f;    // Morgan Thomas turns Theta in oposite direction
+    SCARA_psi   = ik_atan2f(k, SCARA_S2,SCARA_C2);
 
 
-    actuator_mm[ALPHA_STEPPER] = to_degrees(SCARA_theta);             // Multiply by 180/Pi  -  theta is support arm angle
-    actuator_mm[BETA_STEPPER ] = to_degrees(SCARA_theta + SCARA_psi); // Morgan kinematics (dual arm)
+    actuator_mm[ALPHA_STEPPER] = SCARA_theta*(180.0F/3.14159265359f);             // Multiply by 180/Pi  -  theta is support arm angle
+    actuator_mm[BETA_STEPPER ] = (SCARA_theta + SCARA_psi)*(180.0F/3.14159265359f); // Morgan kinematics (dual arm)
     //actuator_mm[BETA_STEPPER ] = to_degrees(SCARA_psi);             // real scara
     actuator_mm[GAMMA_STEPPER] = cartesian_mm[Z_AXIS];                // No inverse kinematics on Z - Position to add bed offset?
 
 }
 
+MorganSCARAIK MorganSCARASolution::get_ik() const
+{
+    MorganSCARAIK k;
+    k.offset_x= this->morgan_offset_x;
+    k.offset_y= this->morgan_offset_y;
+    k.scaling_x= this->morgan_scaling_x;
+    k.scaling_y= this->morgan_scaling_y;
+    if (this->arm1_length == this->arm2_length) {
+        k.c2_sub1= 2.0f*SQ(this->arm1_length);
+        k.c2_sub2= 0.0f;
+    } else {
+        k.c2_sub1= SQ(this->arm1_length);
+        k.c2_sub2= SQ(this->arm2_length);
+    }
+    k.c2_div= 2.0f * SQ(this->arm1_length);
+    k.undefined_min= this->morgan_undefined_min;
+    k.undefined_max= this->morgan_undefined_max;
+    k.arm1_length= this->arm1_length;
+    k.arm2_length= this->arm2_length;
+    k.fast_math= this->fast_math;
+    return k;
+}
+
+void MorganSCARASolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm )
+{
+    morgan_scara_ik(get_ik(), cartesian_mm, actuator_mm);
+}
+
+void MorganSCARASolution::cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    const MorganSCARAIK k= get_ik();
+    for (size_t i = 0; i < n; i++) {
+        morgan_scara_ik(k, cartesian_mm[i], actuator_mm[i]);
+    }
+}
+
 void MorganSCARASolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] ) {
     // Perform forward kinematics, and place results in cartesian_mm[]
 
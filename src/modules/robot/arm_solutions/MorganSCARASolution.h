@@ -4,11 +4,13 @@
 #include "BaseSolution.h"
 
 class Config;
+struct MorganSCARAIK;
 
 class MorganSCARASolution : public BaseSolution {
     public:
         MorganSCARASolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
 
         bool set_optional(const arm_options_t& options) override;
@@ -17,6 +19,7 @@ class MorganSCARASolution : public BaseSolution {
     private:
         void init();
         float to_degrees(float radians);
+        MorganSCARAIK get_ik() const;
 
         float arm1_length;
         float arm2_length;
@@ -27,6 +30,7 @@ class MorganSCARASolution : public BaseSolution {
         float morgan_undefined_min;
         float morgan_undefined_max;
         float slow_rate;
+        bool fast_math;
 };
 
 #endif // MORGANSCARASOLUTION_H
@@ -7,6 +7,7 @@
 #include "libs/nuts_bolts.h"
 #include "libs/Config.h"
 #include "libs/utils.h"
+#include "libs/FastMath.h"
 #include "StreamOutputPool.h"
 #include <fastmath.h>
 
@@ -20,6 +21,7 @@
 #define tool_offset_checksum            CHECKSUM("delta_tool_offset")
 
 #define delta_mirror_xy_checksum        CHECKSUM("delta_mirror_xy")
+#define arm_fast_math_checksum          CHECKSUM("arm_fast_math")
 
 const static float pi     = 3.14159265358979323846;    // PI
 const static float two_pi = 2 * pi;
@@ -56,27 +58,40 @@ RotaryDeltaSolution::RotaryDeltaSolution(Config *config)
     // mirror the XY axis
     mirror_xy= config->value(delta_mirror_xy_checksum)->by_default(true)->as_bool();
 
+    // use the approximations in FastMath.h instead of libm for the inverse kinematics
+    fast_math= config->value(arm_fast_math_checksum)->by_default(false)->as_bool();
+
     debug_flag= false;
     init();
 }
 
+// the parts of the inverse kinematics that only depend on the geometry, worked out once per call or per batch of points
+struct RotaryDeltaIK {
+    float y1;                   // f/2 * tan 30
+    float e_shift;              // e/2 * tan 30
+    float rf, rf_sq, re_sq, y1_sq;
+    bool fast_math;
+};
+
+static inline float ik_atanf(const RotaryDeltaIK &k, float x) { return k.fast_math ? fast_atanf(x) : atanf(x); }
+
 // inverse kinematics
 // helper functions, calculates angle theta1 (for YZ-pane)
-int RotaryDeltaSolution::delta_calcAngleYZ(float x0, float y0, float z0, float &theta)
+static inline int delta_calcAngleYZ(const RotaryDeltaIK &k, float x0, float y0, float z0, float &theta)
 {
-    float y1 = -0.5F * tan30 * delta_f; // f/2 * tan 30
-    y0      -=  0.5F * tan30 * delta_e; // shift center to edge
+    float y1 = k.y1;
+    y0      -= k.e_shift; // shift center to edge
     // z = a + b*y
-    float a = (x0 * x0 + y0 * y0 + z0 * z0 + delta_rf * delta_rf - delta_re * delta_re - y1 * y1) / (2.0F * z0);
+    float a = (x0 * x0 + y0 * y0 + z0 * z0 + k.rf_sq - k.re_sq - k.y1_sq) / (2.0F * z0);
     float b = (y1 - y0) / z0;
 
-    float d = -(a + b * y1) * (a + b * y1) + delta_rf * (b * b * delta_rf + delta_rf); // discriminant
+    float d = -(a + b * y1) * (a + b * y1) + k.rf * (b * b * k.rf + k.rf); // discriminant
     if (d < 0.0F) return -1;                                            // non-existing point
 
     float yj = (y1 - a * b - sqrtf(d)) / (b * b + 1.0F);               // choosing outer point
     float zj = a + b * yj;
 
-    theta = 180.0F * atanf(-zj / (y1 - yj)) / pi + ((yj > y1) ? 180.0F : 0.0F);
+    theta = 180.0F * ik_atanf(k, -zj / (y1 - yj)) / pi + ((yj > y1) ? 180.0F : 0.0F);
     return 0;
 }
 
@@ -140,8 +155,19 @@ void RotaryDeltaSolution::init()
     z_calc_offset  = -(delta_z_offset - tool_offset - delta_ee_offs);
 }
 
+static inline int rotary_delta_ik(const RotaryDeltaIK &k, float x0, float y0, float z_with_offset, float &alpha_theta, float &beta_theta, float &gamma_theta)
+{
+    int status =              delta_calcAngleYZ(k, x0,                    y0,                  z_with_offset, alpha_theta);
+    if (status == 0) status = delta_calcAngleYZ(k, x0 * cos120 + y0 * sin120, y0 * cos120 - x0 * sin120, z_with_offset, beta_theta); // rotate co-ordinates to +120 deg
+    if (status == 0) status = delta_calcAngleYZ(k, x0 * cos120 - y0 * sin120, y0 * cos120 + x0 * sin120, z_with_offset, gamma_theta); // rotate co-ordinates to -120 deg
+    return status;
+}
+
 void RotaryDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], ActuatorCoordinates &actuator_mm )
 {
+    const float y1 = -0.5F * tan30 * delta_f;
+    const RotaryDeltaIK k{y1, 0.5F * tan30 * delta_e, delta_rf, delta_rf * delta_rf, delta_re * delta_re, y1 * y1, fast_math};
+
     //We need to translate the Cartesian coordinates in mm to the actuator position required in mm so the stepper motor  functions
     float alpha_theta = 0.0F;
     float beta_theta  = 0.0F;
@@ -159,9 +185,7 @@ void RotaryDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], Actu
 
     float z_with_offset = cartesian_mm[Z_AXIS] + z_calc_offset; //The delta calculation below places zero at the top.  Subtract the Z offset to make zero at the bottom.
 
-    int status =              delta_calcAngleYZ(x0,                    y0,                  z_with_offset, alpha_theta);
-    if (status == 0) status = delta_calcAngleYZ(x0 * cos120 + y0 * sin120, y0 * cos120 - x0 * sin120, z_with_offset, beta_theta); // rotate co-ordinates to +120 deg
-    if (status == 0) status = delta_calcAngleYZ(x0 * cos120 - y0 * sin120, y0 * cos120 + x0 * sin120, z_with_offset, gamma_theta); // rotate co-ordinates to -120 deg
+    int status = rotary_delta_ik(k, x0, y0, z_with_offset, alpha_theta, beta_theta, gamma_theta);
 
     if (status == -1) { //something went wrong,
         //force to actuator FPD home position as we know this is a valid position
@@ -196,6 +220,27 @@ void RotaryDeltaSolution::cartesian_to_actuator(const float cartesian_mm[], Actu
 
 }
 
+void RotaryDeltaSolution::cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n)
+{
+    const float y1 = -0.5F * tan30 * delta_f;
+    const RotaryDeltaIK k{y1, 0.5F * tan30 * delta_e, delta_rf, delta_rf * delta_rf, delta_re * delta_re, y1 * y1, fast_math};
+
+    for (size_t i = 0; i < n; i++) {
+        float x0 = cartesian_mm[i][X_AXIS];
+        float y0 = cartesian_mm[i][Y_AXIS];
+        if(mirror_xy) {
+            x0= -x0;
+            y0= -y0;
+        }
+
+        float z_with_offset = cartesian_mm[i][Z_AXIS] + z_calc_offset;
+        if(debug_flag || rotary_delta_ik(k, x0, y0, z_with_offset, actuator_mm[i][ALPHA_STEPPER], actuator_mm[i][BETA_STEPPER], actuator_mm[i][GAMMA_STEPPER]) != 0) {
+            // let the single point version handle the failure and the debug output
+            cartesian_to_actuator(cartesian_mm[i], actuator_mm[i]);
+        }
+    }
+}
+
 void RotaryDeltaSolution::actuator_to_cartesian(const ActuatorCoordinates &actuator_mm, float cartesian_mm[] )
 {
     float x, y, z;
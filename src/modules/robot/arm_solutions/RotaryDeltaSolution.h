@@ -9,6 +9,7 @@ class RotaryDeltaSolution : public BaseSolution {
     public:
         RotaryDeltaSolution(Config*);
         void cartesian_to_actuator(const float[], ActuatorCoordinates &) override;
+        void cartesian_to_actuators(const float cartesian_mm[][3], ActuatorCoordinates actuator_mm[], size_t n) override;
         void actuator_to_cartesian(const ActuatorCoordinates &, float[] ) override;
 
         bool set_optional(const arm_options_t& options) override;
@@ -16,7 +17,6 @@ class RotaryDeltaSolution : public BaseSolution {
 
     private:
         void init();
-        int delta_calcAngleYZ(float x0, float y0, float z0, float &theta);
         int delta_calcForward(float theta1, float theta2, float theta3, float &x0, float &y0, float &z0);
 
         float delta_e;			// End effector length
@@ -33,6 +33,7 @@ class RotaryDeltaSolution : public BaseSolution {
         struct {
             bool debug_flag:1;
             bool mirror_xy:1;
+            bool fast_math:1;
         };
 };
 #endif // RotaryDeltaSolution_H
@@ -51,7 +51,8 @@ void Drillingcycles::on_module_loaded()
     this->on_config_reload(this);
 
     // events
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int g : {80, 81, 82, 83, 98, 99})
+        this->register_for_gcode('G', g);
 
     // reset values
     this->cycle_started = false;
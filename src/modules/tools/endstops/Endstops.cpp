@@ -28,6 +28,7 @@
 #include "EndstopsPublicAccess.h"
 #include "StreamOutputPool.h"
 #include "StepTicker.h"
+#include "LoopLatency.h"
 #include "BaseSolution.h"
 #include "SerialMessage.h"
 
@@ -135,7 +136,9 @@ void Endstops::on_module_loaded()
         return;
     }
 
-    register_for_event(ON_GCODE_RECEIVED);
+    register_for_gcode('G', 28);
+    for (int m : {119, 206, 306, 500, 503, 665, 666, 1910})
+        register_for_gcode('M', m);
     register_for_event(ON_GET_PUBLIC_DATA);
     register_for_event(ON_SET_PUBLIC_DATA);
 
@@ -597,6 +600,8 @@ void Endstops::do_homing_corexy(char axes_to_move)
 
 void Endstops::home(char axes_to_move)
 {
+    BlockingWait wait("homing", __builtin_return_address(0));
+
     // not a block move so disable the last tick setting
     for ( int c = X_AXIS; c <= Z_AXIS; c++ ) {
         STEPPER[c]->set_moved_last_block(false);
@@ -60,21 +60,19 @@
 #define retract_recover_feedrate_checksum    CHECKSUM("retract_recover_feedrate")
 #define retract_zlift_length_checksum        CHECKSUM("retract_zlift_length")
 #define retract_zlift_feedrate_checksum      CHECKSUM("retract_zlift_feedrate")
+#define advance_k_checksum                   CHECKSUM("advance_k")
 
 #define X_AXIS      0
 #define Y_AXIS      1
 #define Z_AXIS      2
 
-#define OFF 0
-#define SOLO 1
-#define FOLLOW 2
-
 #define PI 3.14159265358979F
 
 
 /* The extruder module controls a filament extruder for 3D printing: http://en.wikipedia.org/wiki/Fused_deposition_modeling
-* It can work in two modes : either the head does not move, and the extruder moves the filament at a specified speed ( SOLO mode here )
-* or the head moves, and the extruder moves plastic at a speed proportional to the movement of the head ( FOLLOW mode here ).
+* Its motor is one of Robot's motors, so the planner moves it along with the head, within its max speed and acceleration.
+* For each move with an E the Robot asks the extruder how far its motor goes, either in proportion to the movement of the head,
+* or if the head does not move at a specified speed. Firmware retracts are moves of only the extruder too.
 */
 
 Extruder::Extruder( uint16_t config_identifier, bool single )
@@ -88,8 +86,11 @@ Extruder::Extruder( uint16_t config_identifier, bool single )
     this->volumetric_multiplier = 1.0F;
     this->extruder_multiplier = 1.0F;
     this->stepper_motor = nullptr;
+    this->motor = -1;
     this->milestone_last_position = 0;
     this->max_volumetric_rate = 0;
+    this->advance_steps = 0;
+    this->advance_ratio = 0;
 
     memset(this->offset, 0, sizeof(this->offset));
 }
@@ -104,6 +105,8 @@ void Extruder::on_halt(void *arg)
     if(arg == nullptr) {
         // turn off motor
         this->en_pin.set(1);
+        this->advance_ratio = 0;
+        this->advance_steps = 0;
     }
 }
 
@@ -115,21 +118,21 @@ void Extruder::on_module_loaded()
     // Start values
     this->target_position = 0;
     this->current_position = 0;
-    this->unstepped_distance = 0;
-    this->current_block = NULL;
-    this->mode = OFF;
 
-    // We work on the same Block as Stepper, so we need to know when it gets a new one and drops one
+    // The Stepper moves the motor, but the linear advance changes how far, so we need to know when it gets a new block and drops one
     this->register_for_event(ON_BLOCK_BEGIN);
     this->register_for_event(ON_BLOCK_END);
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int g : {0, 1, 2, 3, 10, 11, 90, 91, 92})
+        this->register_for_gcode('G', g);
+    for (int m : {17, 18, 82, 83, 84, 92, 114, 200, 203, 204, 207, 208, 221, 500, 503, 900})
+        this->register_for_gcode('M', m);
     this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_HALT);
     this->register_for_event(ON_SPEED_CHANGE);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
 
-    // Update speed every *acceleration_ticks_per_second*
+    // Update speed every *acceleration_ticks_per_second* when advancing
     THEKERNEL->step_ticker->register_acceleration_tick_handler([this]() {
         acceleration_tick();
     });
@@ -181,14 +184,24 @@ void Extruder::on_config_reload(void *argument)
     this->retract_recover_feedrate = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_recover_feedrate_checksum)->by_default(8)->as_number();
     this->retract_zlift_length     = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_length_checksum)->by_default(0)->as_number();
     this->retract_zlift_feedrate   = THEKERNEL->config->value(extruder_checksum, this->identifier, retract_zlift_feedrate_checksum)->by_default(100 * 60)->as_number(); // mm/min
+    this->advance_k                = THEKERNEL->config->value(extruder_checksum, this->identifier, advance_k_checksum)->by_default(0)->as_number(); // seconds
 
     if(filament_diameter > 0.01F) {
         this->volumetric_multiplier = 1.0F / (powf(this->filament_diameter / 2, 2) * PI);
     }
 
-    // Stepper motor object for the extruder
-    this->stepper_motor = new StepperMotor(step_pin, dir_pin, en_pin);
-    this->stepper_motor->attach(this, &Extruder::stepper_motor_finished_move );
+    // Stepper motor object for the extruder, the planner moves it along with the actuators
+    if(this->stepper_motor == nullptr) {
+        // the dir pin is set for a move back like the actuators, so it is inverted to still be set for a move forward
+        this->dir_pin.set_inverting(!this->dir_pin.is_inverting());
+        this->stepper_motor = new StepperMotor(step_pin, dir_pin, en_pin);
+        this->motor = THEKERNEL->robot->register_motor(this->stepper_motor);
+        if(this->motor < 0) {
+            THEKERNEL->streams->printf("Error: too many extruders, increase MAX_ROBOT_EXTRUDERS\n");
+        }
+    }
+    this->stepper_motor->change_steps_per_mm(this->steps_per_millimeter);
+    this->stepper_motor->set_acceleration(this->acceleration);
     if( this->single_config ) {
         this->stepper_motor->set_max_rate(THEKERNEL->config->value(extruder_max_speed_checksum)->by_default(1000)->as_number());
     } else {
@@ -209,50 +222,29 @@ void Extruder::on_get_public_data(void *argument)
     }
 }
 
-// check against maximum speeds and return the rate modifier
-float Extruder::check_max_speeds(float target, float isecs)
+// check against the maximum volumetric rate and return the rate modifier, delta is the change in E in mm³
+// NOTE the max speed of the motor is checked by Robot along with the actuators
+float Extruder::check_max_volumetric_rate(float delta, float isecs) const
 {
-    float rm = 1.0F; // default no rate modification
-    float delta;
-    // get change in E (may be mm or mm³)
-    if(milestone_absolute_mode) {
-        delta = fabsf(target - milestone_last_position); // delta move
-        milestone_last_position = target;
-
-    } else {
-        delta = target;
-        milestone_last_position += target;
-    }
-
     if(this->max_volumetric_rate > 0 && this->filament_diameter > 0.01F) {
-        // volumetric enabled and check for volumetric rate
-        float v = delta * isecs; // the flow rate in mm³/sec
+        float v = fabsf(delta) * isecs; // the flow rate in mm³/sec
 
         // return the rate change needed to stay within the max rate
         if(v > max_volumetric_rate) {
-            rm = max_volumetric_rate / v;
-            isecs *= rm; // this slows the rate down for the next test
+            return max_volumetric_rate / v;
         }
-        //THEKERNEL->streams->printf("requested flow rate: %f mm³/sec, corrected flow rate: %f  mm³/sec\n", v, v * rm);
     }
+    return 1.0F; // default no rate modification
+}
 
-    // check for max speed as well
-    float max_speed = this->stepper_motor->get_max_rate();
-    if(max_speed > 0) {
-        if(this->filament_diameter > 0.01F) {
-            // volumetric so need to convert delta which is mm³ to mm
-            delta *= volumetric_multiplier;
-        }
-
-        float sm = 1.0F;
-        float v = delta * isecs; // the speed in mm/sec
-        if(v > max_speed) {
-            sm *= (max_speed / v);
-        }
-        //THEKERNEL->streams->printf("requested speed: %f mm/sec, corrected speed: %f  mm/sec\n", v, v * sm);
-        rm *= sm;
+// any F on a G0 to G3 sets the speed for the moves of only the extruder that follow
+void Extruder::set_feed_rate(Gcode *gcode)
+{
+    if (gcode->has_letter('F')) {
+        feed_rate = gcode->get_value('F') / THEKERNEL->robot->get_seconds_per_minute();
+        if (stepper_motor->get_max_rate() > 0 && feed_rate > stepper_motor->get_max_rate())
+            feed_rate = stepper_motor->get_max_rate();
     }
-    return rm;
 }
 
 void Extruder::on_set_public_data(void *argument)
@@ -261,17 +253,35 @@ void Extruder::on_set_public_data(void *argument)
 
     if(!pdr->starts_with(extruder_checksum)) return;
 
-    // handle extrude rates request from robot
+    // handle extrude request from robot, as it plans the move
     if(pdr->second_element_is(target_checksum)) {
         // disabled extruders do not reply NOTE only one enabled extruder supported
-        if(!this->enabled) return;
+        if(!this->enabled || this->motor < 0) return;
 
-        float *d = static_cast<float *>(pdr->get_data_ptr());
-        float target = d[0]; // the E passed in on Gcode is in mm³ (maybe absolute or relative)
-        float isecs = d[1]; // inverted secs
+        pad_extruder_move *move = static_cast<pad_extruder_move *>(pdr->get_data_ptr());
+        set_feed_rate(move->gcode);
 
-        // check against maximum speeds and return rate modifier
-        d[1] = check_max_speeds(target, isecs);
+        // get change in E (may be mm or mm³)
+        float e = move->gcode->get_value('E');
+        float delta;
+        if(milestone_absolute_mode) {
+            delta = e - milestone_last_position;
+            milestone_last_position = e;
+        } else {
+            delta = e;
+            milestone_last_position += e;
+        }
+
+        move->motor = this->motor;
+        if(move->isecs > 0.0F) {
+            // We move proportionally to the robot's movement, adjusted for volumetric extrusion and the extruder multiplier
+            move->distance = delta * this->volumetric_multiplier * this->extruder_multiplier;
+            move->rate = check_max_volumetric_rate(delta, move->isecs);
+        } else {
+            // the head does not move, so the extruder moves the E in mm at the feed rate
+            move->distance = delta;
+            move->rate = this->feed_rate;
+        }
 
         pdr->set_taken();
         return;
@@ -284,7 +294,7 @@ void Extruder::on_set_public_data(void *argument)
         pdr->set_taken();
     } else if(pdr->second_element_is(restore_state_checksum)) {
         // NOTE this only gets called when the queue is empty so the milestones will be the same
-        this->milestone_last_position= this->current_position = this->saved_current_position;
+        this->milestone_last_position= this->target_position= this->current_position = this->saved_current_position;
         this->milestone_absolute_mode= this->absolute_mode = this->saved_absolute_mode;
         pdr->set_taken();
     }
@@ -306,6 +316,7 @@ void Extruder::on_gcode_received(void *argument)
             if (gcode->has_letter('E')) {
                 spm = gcode->get_value('E');
                 this->steps_per_millimeter = spm;
+                this->stepper_motor->change_steps_per_mm(spm);
             }
 
             gcode->stream->printf("E:%g ", spm);
@@ -347,6 +358,7 @@ void Extruder::on_gcode_received(void *argument)
                    ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // extruder acceleration M204 Ennn mm/sec^2 (Pnnn sets the specific extruder for M500)
             this->acceleration = gcode->get_value('E');
+            this->stepper_motor->set_acceleration(this->acceleration);
 
         } else if (gcode->m == 207 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
             // M207 - set retract length S[positive mm] F[feedrate mm/min] Z[additional zlift/hop] Q[zlift feedrate mm/min]
@@ -360,6 +372,16 @@ void Extruder::on_gcode_received(void *argument)
             if(gcode->has_letter('S')) retract_recover_length = gcode->get_value('S');
             if(gcode->has_letter('F')) retract_recover_feedrate = gcode->get_value('F') / 60.0F; // specified in mm/min converted to mm/sec
 
+        } else if (gcode->m == 900 && ( (this->enabled && !gcode->has_letter('P')) || (gcode->has_letter('P') && gcode->get_value('P') == this->identifier)) ) {
+            // M900 Knnn - set linear advance in seconds, mm of filament ahead per mm/sec of filament speed, 0 disables
+            if(gcode->has_letter('K')) {
+                float k = gcode->get_value('K');
+                this->advance_k = k > 0 ? k : 0;
+            } else {
+                gcode->stream->printf("K:%g", this->advance_k);
+                gcode->add_nl = true;
+            }
+
         } else if (gcode->m == 221 && this->enabled) { // M221 S100 change flow rate by percentage
             if(gcode->has_letter('S')) {
                 this->extruder_multiplier = gcode->get_value('S') / 100.0F;
@@ -375,6 +397,7 @@ void Extruder::on_gcode_received(void *argument)
                 gcode->stream->printf(";E retract recover length, feedrate:\nM208 S%1.4f F%1.4f\n", this->retract_recover_length, this->retract_recover_feedrate * 60.0F);
                 gcode->stream->printf(";E acceleration mm/sec²:\nM204 E%1.4f\n", this->acceleration);
                 gcode->stream->printf(";E max feed rate mm/sec:\nM203 E%1.4f\n", this->stepper_motor->get_max_rate());
+                gcode->stream->printf(";E linear advance seconds:\nM900 K%1.4f\n", this->advance_k);
                 if(this->max_volumetric_rate > 0) {
                     gcode->stream->printf(";E max volumetric rate mm³/sec:\nM203 V%1.4f\n", this->max_volumetric_rate);
                 }
@@ -386,6 +409,7 @@ void Extruder::on_gcode_received(void *argument)
                 gcode->stream->printf(";E retract recover length, feedrate:\nM208 S%1.4f F%1.4f P%d\n", this->retract_recover_length, this->retract_recover_feedrate * 60.0F, this->identifier);
                 gcode->stream->printf(";E acceleration mm/sec²:\nM204 E%1.4f P%d\n", this->acceleration, this->identifier);
                 gcode->stream->printf(";E max feed rate mm/sec:\nM203 E%1.4f P%d\n", this->stepper_motor->get_max_rate(), this->identifier);
+                gcode->stream->printf(";E linear advance seconds:\nM900 K%1.4f P%d\n", this->advance_k, this->identifier);
                 if(this->max_volumetric_rate > 0) {
                     gcode->stream->printf(";E max volumetric rate mm³/sec:\nM203 V%1.4f P%d\n", this->max_volumetric_rate, this->identifier);
                 }
@@ -398,17 +422,16 @@ void Extruder::on_gcode_received(void *argument)
         }
 
     } else if(gcode->has_g) {
+        // the Robot has planned the move, and asked for its E if it had one, but the F is for the moves of only the extruder too
+        if( this->enabled && gcode->g < 4 ) {
+            set_feed_rate(gcode);
+        }
+
         // G codes, NOTE some are ignored if not enabled
         if( (gcode->g == 92 && gcode->has_letter('E')) || (gcode->g == 90 || gcode->g == 91) ) {
             // Gcodes to pass along to on_gcode_execute
             THEKERNEL->conveyor->append_gcode(gcode);
 
-        } else if( this->enabled && gcode->g < 4 && gcode->has_letter('E') && fabsf(gcode->millimeters_of_travel) < 0.00001F ) { // With floating numbers, we can have 0 != 0, NOTE needs to be same as in Robot.cpp#745
-            // NOTE was ... gcode->has_letter('E') && !gcode->has_letter('X') && !gcode->has_letter('Y') && !gcode->has_letter('Z') ) {
-            // This is a SOLO move, we add an empty block to the queue to prevent subsequent gcodes being executed at the same time
-            THEKERNEL->conveyor->append_gcode(gcode);
-            THEKERNEL->conveyor->queue_head_block();
-
         } else if( this->enabled && (gcode->g == 10 || gcode->g == 11) && !gcode->has_letter('L') ) {
             // firmware retract command (Ignore if has L parameter that is not for us)
             // check we are in the correct state of retract or unretract
@@ -435,9 +458,11 @@ void Extruder::on_gcode_received(void *argument)
                 THEKERNEL->robot->pop_state(); // restore state includes feed rates etc
             }
 
-            // This is a solo move, we add an empty block to the queue to prevent subsequent gcodes being executed at the same time
+            // the retract is a move of only the extruder, in mm even when the E is volumetric
+            float distance = gcode->g == 10 ? -retract_length : retract_length + retract_recover_length;
+            this->milestone_last_position += distance;
             THEKERNEL->conveyor->append_gcode(gcode);
-            THEKERNEL->conveyor->queue_head_block();
+            THEKERNEL->robot->append_motor_move(this->motor, distance, gcode->g == 10 ? retract_feedrate : retract_recover_feedrate);
 
             if(retract_zlift_length > 0 && gcode->g == 10) {
                 char buf[32];
@@ -474,21 +499,22 @@ void Extruder::on_gcode_received(void *argument)
                         this->milestone_last_position = gcode->get_value('E');
                     } else if(gcode->get_num_args() == 0) {
                         this->milestone_last_position = 0;
+                    } else {
+                        break;
                     }
+                    // only the moves from here on count, so the motor position in mm stays small enough for a float to keep every step
+                    this->stepper_motor->change_last_milestone(0);
                 }
                 break;
         }
     }
 }
 
-// Compute extrusion speed based on parameters and gcode distance of travel
+// Keep track of the E of the moves as they are executed
 void Extruder::on_gcode_execute(void *argument)
 {
     Gcode *gcode = static_cast<Gcode *>(argument);
 
-    // The mode is OFF by default, and SOLO or FOLLOW only if we need to extrude
-    this->mode = OFF;
-
     // Absolute/relative mode, globably modal affect all extruders whether enabled or not
     if( gcode->has_m ) {
         switch(gcode->m) {
@@ -522,193 +548,112 @@ void Extruder::on_gcode_execute(void *argument)
             if( gcode->has_letter('E') ) {
                 this->current_position = gcode->get_value('E');
                 this->target_position  = this->current_position;
-                this->unstepped_distance = 0;
             } else if( gcode->get_num_args() == 0) {
                 this->current_position = 0.0;
                 this->target_position = this->current_position;
-                this->unstepped_distance = 0;
             }
 
         } else if (gcode->g == 10) {
             // FW retract command
-            feed_rate = retract_feedrate; // mm/sec
-            this->mode = SOLO;
-            this->travel_distance = -retract_length;
-            this->target_position += this->travel_distance;
+            this->target_position -= retract_length;
+            this->current_position = this->target_position;
             this->en_pin.set(0);
 
         } else if (gcode->g == 11) {
             // un retract command
-            feed_rate = retract_recover_feedrate; // mm/sec
-            this->mode = SOLO;
-            this->travel_distance = (retract_length + retract_recover_length);
-            this->target_position += this->travel_distance;
+            this->target_position += (retract_length + retract_recover_length);
+            this->current_position = this->target_position;
             this->en_pin.set(0);
 
-        } else if (gcode->g <= 3) {
-            // Extrusion length from 'G' Gcode
-            if( gcode->has_letter('E' )) {
-                // Get relative extrusion distance depending on mode ( in absolute mode we must subtract target_position )
-                float extrusion_distance = gcode->get_value('E');
-                float relative_extrusion_distance = extrusion_distance;
-                if (this->absolute_mode) {
-                    relative_extrusion_distance -= this->target_position;
-                    this->target_position = extrusion_distance;
-                } else {
-                    this->target_position += relative_extrusion_distance;
-                }
-
-                // If the robot is moving, we follow it's movement, otherwise, we move alone
-                if( fabsf(gcode->millimeters_of_travel) < 0.00001F ) { // With floating numbers, we can have 0 != 0, NOTE needs to be same as in Robot.cpp#745
-                    this->mode = SOLO;
-                    this->travel_distance = relative_extrusion_distance;
-                } else {
-                    // We move proportionally to the robot's movement
-                    this->mode = FOLLOW;
-                    this->travel_ratio = (relative_extrusion_distance * this->volumetric_multiplier * this->extruder_multiplier) / gcode->millimeters_of_travel; // adjust for volumetric extrusion and extruder multiplier
-                }
-
-                this->en_pin.set(0);
-            }
-
-            // NOTE this is only used in SOLO mode, but any F on a G0/G1 will set the speed for future retracts that are not firmware retracts
-            if (gcode->has_letter('F')) {
-                feed_rate = gcode->get_value('F') / THEKERNEL->robot->get_seconds_per_minute();
-                if (stepper_motor->get_max_rate() > 0 && feed_rate > stepper_motor->get_max_rate())
-                    feed_rate = stepper_motor->get_max_rate();
+        } else if (gcode->g <= 3 && gcode->has_letter('E')) {
+            // Extrusion length from 'G' Gcode, the motor was given its part of the move when it was planned
+            if (this->absolute_mode) {
+                this->target_position = gcode->get_value('E');
+            } else {
+                this->target_position += gcode->get_value('E');
             }
+            this->current_position = this->target_position;
+            this->en_pin.set(0);
         }
     }
 }
 
-// When a new block begins, either follow the robot, or step by ourselves ( or stay back and do nothing )
+// The Stepper has already set the motor moving with the block. When the block moves it forward along with the head, the linear
+// advance adds what it needs to be ahead by at the end of the block, and the acceleration tick sets its speed to get there.
+// Any other block it follows the head in takes back what it was ahead by. A block it is the main stepper of, a retract or an E
+// only move, is timed by the Stepper off its planned steps so it moves as planned, and like a block it does not move in keeps
+// the lead for the next block it follows in.
 void Extruder::on_block_begin(void *argument)
 {
-    if(!this->enabled) return;
-
-    if( this->mode == OFF ) {
-        this->current_block = NULL;
-        this->stepper_motor->set_moved_last_block(false);
-        return;
-    }
+    if(!this->enabled || this->motor < 0) return;
 
     Block *block = static_cast<Block *>(argument);
-    if( this->mode == FOLLOW ) {
-        // In FOLLOW mode, we just follow the stepper module
-        this->travel_distance = block->millimeters * this->travel_ratio;
-    }
-
-    // common for both FOLLOW and SOLO
-    this->current_position += this->travel_distance ;
-
-    // round down, we take care of the fractional part next time
-    int steps_to_step = abs((int)floorf(this->steps_per_millimeter * (this->travel_distance + this->unstepped_distance) ));
-
-    // accumulate the fractional part
-    if ( this->travel_distance > 0 ) {
-        this->unstepped_distance += this->travel_distance - (steps_to_step / this->steps_per_millimeter);
-    } else {
-        this->unstepped_distance += this->travel_distance + (steps_to_step / this->steps_per_millimeter);
-    }
-
-    if( steps_to_step != 0 ) {
-        // We take the block, we have to release it or everything gets stuck
-        block->take();
-        this->current_block = block;
-        this->stepper_motor->move( (this->travel_distance > 0), steps_to_step);
-
-        if(this->mode == FOLLOW) {
-            on_speed_change(this); // set initial speed
-            this->stepper_motor->set_moved_last_block(true);
-        } else {
-            // SOLO
-            uint32_t target_rate = floorf(this->feed_rate * this->steps_per_millimeter);
-            this->stepper_motor->set_speed(min( target_rate, rate_increase() ));  // start at first acceleration step
-            this->stepper_motor->set_moved_last_block(false);
-        }
-
-    } else {
-        // no steps to take this time
-        this->current_block = NULL;
-        this->stepper_motor->set_moved_last_block(false);
+    this->advance_ratio = 0;
+    int32_t planned = block->steps[this->motor];
+    if(planned == 0 || (this->advance_k <= 0 && this->advance_steps == 0)) return;
+    if((block->direction_bits >> this->motor) & 1) planned = -planned;
+
+    if(THEKERNEL->stepper->get_main_stepper() == this->stepper_motor) return;
+
+    bool advanced = planned > 0 && this->advance_k > 0;
+    int32_t advance = 0;
+    if(advanced) {
+        // advance_k times the filament speed at the end of the block, in steps
+        advance = lroundf(this->advance_k * block->final_rate * planned / block->steps_event_count);
     }
 
+    int32_t steps = planned + advance - this->advance_steps;
+    this->advance_steps = advance;
+    if(steps == planned && !advanced) return;
+
+    // the acceleration tick follows the main stepper from the first tick on, the extra speed while it accelerates adds up to
+    // advance_gain * (final_rate - initial_rate) steps over the block, and the rest of the steps are spread over it evenly
+    this->advance_gain = advanced ? this->advance_k * planned / block->steps_event_count : 0.0F;
+    float even_steps = abs(steps) - this->advance_gain * ((float)block->final_rate - block->initial_rate);
+    this->advance_ratio = max(even_steps, 1.0F) / block->steps_event_count;
+    this->advance_last_rate = THEKERNEL->stepper->get_trapezoid_adjusted_rate();
+    this->stepper_motor->move(steps < 0, abs(steps), this->advance_last_rate * this->advance_ratio);
 }
 
-// When a block ends, pause the stepping interrupt
+// When a block ends, the acceleration tick leaves the motor alone
 void Extruder::on_block_end(void *argument)
 {
-    if(!this->enabled) return;
-    this->current_block = NULL;
+    this->advance_ratio = 0;
 }
 
-uint32_t Extruder::rate_increase() const
-{
-    return floorf((this->acceleration / THEKERNEL->acceleration_ticks_per_second) * this->steps_per_millimeter);
-}
-
-// Called periodically to change the speed to match acceleration or to match the speed of the robot
-// Only used in SOLO mode
+// Called periodically to change the speed to match the speed of the robot, only when the block is advanced or the extruder
+// takes back what it was ahead by
 void Extruder::acceleration_tick(void)
 {
     // Avoid trying to work when we really shouldn't ( between blocks or re-entry )
-    if(!this->enabled || this->mode != SOLO || this->current_block == NULL || !this->stepper_motor->is_moving() ) {
+    if(!this->enabled || this->advance_ratio <= 0 || !this->stepper_motor->is_moving() ) {
         return;
     }
 
-    uint32_t current_rate = this->stepper_motor->get_steps_per_second();
-    uint32_t target_rate = floorf(this->feed_rate * this->steps_per_millimeter);
-
-    if( current_rate < target_rate ) {
-        current_rate = min( target_rate, current_rate + rate_increase() );
-        // steps per second
-        this->stepper_motor->set_speed(current_rate);
-    }
-
-    return;
+    advance_tick();
 }
 
-// Speed has been updated for the robot's stepper, we must update accordingly
-void Extruder::on_speed_change( void *argument )
+// Follow the robot with the extra filament speed the linear advance needs while the robot accelerates, the Stepper has already
+// set the rate for this tick as its handler was registered first. The extra speed is advance_k times the acceleration of the
+// filament, taken from the change in rate since the last tick
+// NOTE the speed is not taken below the minimum step rate, when decelerating hard the extruder gets ahead and finishes early
+void Extruder::advance_tick()
 {
-    // Avoid trying to work when we really shouldn't ( between blocks or re-entry )
-    if(!this->enabled || this->current_block == NULL || this->mode != FOLLOW || !this->stepper_motor->is_moving()) {
-        return;
-    }
+    float rate = THEKERNEL->stepper->get_trapezoid_adjusted_rate();
+    float acceleration = (rate - this->advance_last_rate) * THEKERNEL->acceleration_ticks_per_second; // main stepper steps/sec²
+    this->advance_last_rate = rate;
 
-    // if we are flushing the queue we need to stop the motor when it has decelerated to zero, we get this call with argumnet == 0 when this happens
-    // this is what steppermotor does
-    if(argument == 0) {
-        this->stepper_motor->move(0, 0);
-        this->current_block->release();
-        this->current_block = NULL;
-        return;
+    float speed = rate * this->advance_ratio + this->advance_gain * acceleration;
+    if(speed != this->stepper_motor->get_steps_per_second()) {
+        this->stepper_motor->set_speed(speed);
     }
-
-    /*
-    * nominal block duration = current block's steps / ( current block's nominal rate )
-    * nominal extruder rate = extruder steps / nominal block duration
-    * actual extruder rate = nominal extruder rate * ( ( stepper's steps per second ) / ( current block's nominal rate ) )
-    * or actual extruder rate = ( ( extruder steps * ( current block's nominal_rate ) ) / current block's steps ) * ( ( stepper's steps per second ) / ( current block's nominal rate ) )
-    * or simplified : extruder steps * ( stepper's steps per second ) ) / current block's steps
-    * or even : ( stepper steps per second ) * ( extruder steps / current block's steps )
-    */
-
-    this->stepper_motor->set_speed(THEKERNEL->stepper->get_trapezoid_adjusted_rate() * (float)this->stepper_motor->get_steps_to_move() / (float)this->current_block->steps_event_count);
 }
 
-// When the stepper has finished it's move
-uint32_t Extruder::stepper_motor_finished_move(uint32_t dummy)
+// if we are flushing the queue the Stepper stops all the motors when it has decelerated to zero, we get this call with argument == 0 when this happens
+void Extruder::on_speed_change( void *argument )
 {
-    if(!this->enabled) return 0;
-
-    //printf("extruder releasing\r\n");
-
-    if (this->current_block) { // this should always be true, but sometimes it isn't. TODO: find out why
-        Block *block = this->current_block;
-        this->current_block = NULL;
-        block->release();
+    if(argument == 0) {
+        this->advance_ratio = 0;
+        this->advance_steps = 0; // where it stopped is unknown
     }
-    return 0;
-
 }
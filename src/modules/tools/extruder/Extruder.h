@@ -15,6 +15,7 @@
 
 class StepperMotor;
 class Block;
+class Gcode;
 
 // NOTE Tool is also a module, no need for multiple inheritance here
 class Extruder : public Tool {
@@ -31,41 +32,43 @@ class Extruder : public Tool {
         void     on_halt(void* argument);
         void     on_speed_change(void* argument);
         void     acceleration_tick(void);
-        uint32_t stepper_motor_finished_move(uint32_t dummy);
-        Block*   append_empty_block();
 
     private:
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
-        uint32_t rate_increase() const;
-        float check_max_speeds(float target, float isecs);
+        void advance_tick();
+        void set_feed_rate(Gcode *gcode);
+        float check_max_volumetric_rate(float delta, float isecs) const;
 
         StepperMotor*  stepper_motor;
+        int            motor;                        // index of stepper_motor in Robot::motors, -1 if there was no room for it
         Pin            step_pin;                     // Step pin for the stepper driver
         Pin            dir_pin;                      // Dir pin for the stepper driver
         Pin            en_pin;
         float          target_position;              // End point ( in mm ) for the current move
-        float          unstepped_distance;           // overflow buffer for requested moves that are less than 1 step
-        Block*         current_block;                // Current block we are stepping, same as Stepper's one
 
         // kept together so they can be passed as public data
         struct {
             float steps_per_millimeter;         // Steps to travel one millimeter
             float filament_diameter;            // filament diameter
             float extruder_multiplier;          // flow rate 1.0 == 100%
-            float acceleration;                 // extruder accleration SOLO setting
+            float acceleration;                 // extruder accleration, the planner keeps the blocks it moves in under it
             float retract_length;               // firmware retract length
             float current_position;             // Current point ( in mm ) for the current move, incremented every time a move is executed
         };
 
         float saved_current_position;
         float volumetric_multiplier;
-        float feed_rate;                // default rate mm/sec for SOLO moves only
-        float milestone_last_position;  // used for calculating volumemetric rate, last position in mm³
+        float feed_rate;                // default rate mm/sec for moves of only the extruder
+        float milestone_last_position;  // E of the last move planned, in mm or mm³, what the next absolute E is relative to
         float max_volumetric_rate;      // used for calculating volumetric rate in mm³/sec
 
-        float travel_ratio;
-        float travel_distance;
+        // linear advance, the extruder is kept advance_k times the filament speed ahead to make up for the pressure in the nozzle
+        float advance_k;                // seconds, mm ahead per mm/sec of filament
+        int32_t advance_steps;          // steps the extruder will be ahead of where it was planned by at the end of the current block
+        float advance_ratio;            // extruder steps per main stepper step when the acceleration tick sets its speed, 0 when it does not
+        float advance_gain;             // and its extra steps per main stepper step/sec of acceleration, 0 when it is not advancing
+        float advance_last_rate;        // the main stepper rate at the last acceleration tick
 
         // for firmware retract
         float retract_feedrate;
@@ -75,7 +78,6 @@ class Extruder : public Tool {
         float retract_zlift_feedrate;
 
         struct {
-            char mode:3;        // extruder motion mode,  OFF, SOLO, or FOLLOW
             bool absolute_mode:1; // absolute/relative coordinate mode switch
             bool saved_absolute_mode:1;
             bool single_config:1;
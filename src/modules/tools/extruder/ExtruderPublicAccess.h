@@ -4,3 +4,14 @@
 #define save_state_checksum                  CHECKSUM("save_state")
 #define restore_state_checksum               CHECKSUM("restore_state")
 #define target_checksum                      CHECKSUM("target")
+
+class Gcode;
+
+// passed with target_checksum by Robot for each move with an E, the enabled extruder fills in how its motor moves with it
+struct pad_extruder_move {
+    Gcode *gcode;       // the G0 to G3 with the E
+    float isecs;        // inverse of the seconds the move takes at the requested rate, 0 if only the extruder moves
+    float distance;     // how far the extruder motor moves in mm
+    float rate;         // the rate modifier for the move, or the rate in mm/sec of a move of only the extruder
+    int motor;          // the extruder motor, its index in Robot::motors
+};
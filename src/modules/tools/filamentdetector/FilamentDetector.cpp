@@ -95,7 +95,8 @@ void FilamentDetector::on_module_loaded()
 
     register_for_event(ON_MAIN_LOOP);
     register_for_event(ON_CONSOLE_LINE_RECEIVED);
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int m : {404, 405, 406, 407})
+        this->register_for_gcode('M', m);
 }
 
 
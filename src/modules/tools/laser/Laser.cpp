@@ -16,11 +16,14 @@
 #include "Block.h"
 #include "checksumm.h"
 #include "ConfigValue.h"
+#include "StepperMotor.h"
 
 #include "libs/Pin.h"
 #include "Gcode.h"
 #include "PwmOut.h" // mbed.h lib
 
+#include <math.h>
+
 #define laser_module_enable_checksum          	CHECKSUM("laser_module_enable")
 #define laser_module_pin_checksum          	    CHECKSUM("laser_module_pin")
 #define laser_module_pwm_pin_checksum          	CHECKSUM("laser_module_pwm_pin")
@@ -96,8 +99,13 @@ void Laser::on_module_loaded() {
     // S value that represents maximum (default 1)
     this->laser_maximum_s_value = THEKERNEL->config->value(laser_module_maximum_s_value_checksum)->by_default(1.0f)->as_number() ;
 
+    this->laser_on = false;
+    this->minimum_duty = this->laser_minimum_power > 0 ? this->laser_minimum_power * 16777216.0F : 0;
+    this->level_duty = 0;
+    this->pixel_level = 255;
+    this->pixel_count = 0;
+
     //register for events
-    this->register_for_event(ON_GCODE_EXECUTE);
     this->register_for_event(ON_SPEED_CHANGE);
     this->register_for_event(ON_BLOCK_BEGIN);
     this->register_for_event(ON_BLOCK_END);
@@ -106,6 +114,8 @@ void Laser::on_module_loaded() {
 
 // Turn laser off laser at the end of a move
 void  Laser::on_block_end(void* argument){
+    // off until the next block begins, the stepper changes the speed for that before we get its on_block_begin
+    this->laser_on = false;
     this->pwm_pin->write(this->pwm_inverting ? 1 : 0);
 
     if (this->ttl_used) {
@@ -116,38 +126,51 @@ void  Laser::on_block_end(void* argument){
     }
 }
 
-// Set laser power at the beginning of a block
+// Set laser power at the beginning of a block, from the motion and S the planner stored in it
 void Laser::on_block_begin(void* argument){
-    this->set_proportional_power();
+    Block* block = static_cast<Block*>(argument);
 
-}
+    this->laser_on = block->is_g123;
 
-// Turn laser on/off depending on received GCodes
-void Laser::on_gcode_execute(void* argument){
-    Gcode* gcode = static_cast<Gcode*>(argument);
-    this->laser_on = false;
-    if( gcode->has_g){
-        int code = gcode->g;
-        if( code == 0 ){                    // G0
-            this->pwm_pin->write(this->pwm_inverting ? 1 - this->laser_minimum_power : this->laser_minimum_power);
-            this->laser_on =  false;
-        }else if( code >= 1 && code <= 3 ){ // G1, G2, G3
-            this->laser_on =  true;
-        }
+    if (block->s_value >= 0.0F) {
+        float requested_power = block->s_value / this->laser_maximum_s_value;
+        // Ensure we can't exceed maximum power
+        if (requested_power > 1)
+            requested_power = 1;
+
+        this->laser_power = requested_power;
     }
 
-    if ( gcode->has_letter('S' )){
-    	float requested_power = gcode->get_value('S') / this->laser_maximum_s_value;
-    	// Ensure we can't exceed maximum power
-    	if (requested_power > 1)
-    		requested_power = 1;
+    if (this->laser_on) {
+        // the power at the nominal rate less the minimum, so on_speed_change only has to scale it by the rate
+        this->power_per_rate = block->nominal_rate > 0 ? (this->laser_maximum_power - this->laser_minimum_power) * this->laser_power / block->nominal_rate : 0;
+
+        this->pixel_count = 0;
+        this->pixel_level = 255;
+        const RasterSlice *raster = block->get_raster();
+        if (raster != nullptr && raster->pixel_count > 0 && THEKERNEL->stepper->get_current_block() == block) {
+            // a G7, the power changes to each pixel's as the main stepper gets to it
+            this->pixels = raster->line->pixels() + raster->first_pixel;
+            this->pixel_count = raster->pixel_count;
+            this->pixel = 0;
+            this->pixel_steps = block->steps_event_count / raster->pixel_count;
+            this->pixel_remainder = block->steps_event_count % raster->pixel_count;
+            this->next_start = this->pixel_steps;
+            this->next_start_remainder = this->pixel_remainder;
+            this->pixel_level = this->pixels[0];
+            if (this->pixel_count > 1)
+                THEKERNEL->stepper->get_main_stepper()->set_step_hook(this, &Laser::next_pixel, this->next_start + (this->next_start_remainder > 0));
+        }
 
-        this->laser_power = requested_power;
+        this->set_proportional_power();
+
+    } else {
+        // G0
+        this->pwm_pin->write(this->pwm_inverting ? 1 - this->laser_minimum_power : this->laser_minimum_power);
     }
 
     if (this->ttl_used)
         this->ttl_pin->set(this->laser_on);
-
 }
 
 // We follow the stepper module here, so speed must be proportional
@@ -157,11 +180,43 @@ void Laser::on_speed_change(void* argument){
     }
 }
 
+// Called in the step interrupt when the main stepper gets to the next pixel of a G7, returns the step the one after starts at
+uint32_t Laser::next_pixel(uint32_t stepped){
+    // pixels shorter than a step are skipped, the last one that starts by this step is used
+    uint32_t next;
+    do {
+        this->pixel++;
+        this->next_start += this->pixel_steps;
+        this->next_start_remainder += this->pixel_remainder;
+        if (this->next_start_remainder >= this->pixel_count) {
+            this->next_start_remainder -= this->pixel_count;
+            this->next_start++;
+        }
+        next = this->next_start + (this->next_start_remainder > 0);
+    } while (this->pixel + 1 < this->pixel_count && next <= stepped);
+
+    this->pixel_level = this->pixels[this->pixel];
+    this->write_pixel_power();
+    return this->pixel + 1 < this->pixel_count ? next : 0;
+}
+
+// Write the duty for the current pixel level at the power set_proportional_power() last worked out for the rate
+void Laser::write_pixel_power(){
+    uint32_t duty = this->minimum_duty + this->level_duty * this->pixel_level;
+    if (duty > 16777216) duty = 16777216;
+    this->pwm_pin->write((this->pwm_inverting ? 16777216 - duty : duty) * (1.0F / 16777216));
+}
+
 void Laser::set_proportional_power(){
     if( this->laser_on && THEKERNEL->stepper->get_current_block() ){
-        // adjust power to maximum power and actual velocity
-        float proportional_power = (((this->laser_maximum_power-this->laser_minimum_power)*(this->laser_power * THEKERNEL->stepper->get_trapezoid_adjusted_rate() / THEKERNEL->stepper->get_current_block()->nominal_rate))+this->laser_minimum_power);
-        this->pwm_pin->write(this->pwm_inverting ? 1 - proportional_power : proportional_power);
+        // adjust power to maximum power and actual velocity, the pixel of a raster line is applied when writing it
+        float level_duty = this->power_per_rate * THEKERNEL->stepper->get_trapezoid_adjusted_rate() * (16777216.0F / 255);
+        // the step interrupt can change the pixel while the acceleration tick is here, so it must not interrupt the write
+        uint32_t primask = __get_PRIMASK();
+        __disable_irq();
+        this->level_duty = level_duty > 0 ? level_duty : 0;
+        this->write_pixel_power();
+        __set_PRIMASK(primask);
     }
 }
 
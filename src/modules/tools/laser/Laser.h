@@ -22,12 +22,13 @@ class Laser : public Module{
         void on_module_loaded();
         void on_block_end(void* argument);
         void on_block_begin(void* argument);
-        void on_gcode_execute(void* argument);
         void on_speed_change(void* argument);
         void on_halt(void* argument);
 
     private:
         void set_proportional_power();
+        void write_pixel_power();
+        uint32_t next_pixel(uint32_t stepped);
         mbed::PwmOut *pwm_pin;    // PWM output to regulate the laser power
         Pin *ttl_pin;				// TTL output to fire laser
         struct {
@@ -40,6 +41,23 @@ class Laser : public Module{
         float            laser_minimum_power; // value used to tickle the laser on moves.  Also minimum value for auto-scaling
         float            laser_power;     // current laser power
         float            laser_maximum_s_value; // Value of S code that will represent max power
+        float            power_per_rate;  // power above the minimum for each step per second of the current block
+
+        // the duty is minimum_duty + level_duty * the pixel level, in 24 bit fixed point so the step hook has no float math to do
+        uint32_t         minimum_duty;
+        volatile uint32_t level_duty;     // the duty above the minimum for each pixel level at the current rate
+        volatile uint8_t pixel_level;     // of the current pixel of a G7 raster line from 0 to 255, 255 for other moves
+
+        // the pixels of the current block when it is part of a G7, pixel n starts at step ceil(n * steps_event_count / pixel_count)
+        // of the main stepper. Where the next one starts is kept as a quotient and remainder and moved on a pixel by adding
+        // pixel_steps and pixel_remainder, steps_event_count / pixel_count and steps_event_count % pixel_count
+        const uint8_t   *pixels;
+        uint16_t         pixel_count;
+        uint16_t         pixel;
+        uint32_t         pixel_steps;
+        uint32_t         pixel_remainder;
+        uint32_t         next_start;
+        uint32_t         next_start_remainder;
 };
 
 #endif
@@ -24,7 +24,8 @@ void RotaryDeltaCalibration::on_module_loaded()
     }
 
     // register event-handlers
-    register_for_event(ON_GCODE_RECEIVED);
+    register_for_gcode('M', 206);
+    register_for_gcode('M', 306);
 }
 
 float *RotaryDeltaCalibration::get_homing_offset()
@@ -48,7 +48,8 @@ void SCARAcal::on_module_loaded()
     // load settings
     this->on_config_reload(this);
     // register event-handlers
-    register_for_event(ON_GCODE_RECEIVED);
+    for (int m : {114, 360, 361, 364, 366})
+        register_for_gcode('M', m);
 }
 
 void SCARAcal::on_config_reload(void *argument)
@@ -31,6 +31,7 @@ class Switch : public Module {
         void on_main_loop(void *argument);
         void on_config_reload(void* argument);
         void on_gcode_received(void* argument);
+        void on_gcode_execute(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
         void on_halt(void *arg);
@@ -72,6 +72,8 @@ TemperatureControl::TemperatureControl(uint16_t name, int index)
     temp_violated= false;
     sensor= nullptr;
     readonly= false;
+    queued_count= 0;
+    applied_count= 0;
 }
 
 TemperatureControl::~TemperatureControl()
@@ -90,10 +92,15 @@ void TemperatureControl::on_module_loaded()
     this->load_config();
 
     // Register for events
-    this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('M', this->get_m_code);
+    this->register_for_gcode('M', this->set_m_code);
+    this->register_for_gcode('M', this->set_and_wait_m_code);
+    for (int m : {143, 301, 305, 500, 503})
+        this->register_for_gcode('M', m);
     this->register_for_event(ON_GET_PUBLIC_DATA);
 
     if(!this->readonly) {
+        this->register_for_event(ON_GCODE_EXECUTE);
         this->register_for_event(ON_SECOND_TICK);
         this->register_for_event(ON_MAIN_LOOP);
         this->register_for_event(ON_SET_PUBLIC_DATA);
@@ -108,11 +115,23 @@ void TemperatureControl::on_halt(void *arg)
         this->o = 0;
         this->heater_pin.set(0);
         this->target_temperature = UNDEFINED;
+        this->applied_count = this->queued_count;
     }
 }
 
 void TemperatureControl::on_main_loop(void *argument)
 {
+    if (this->applied_count != this->queued_count) {
+        this->applied_count = this->queued_count;
+        float v = this->queued_temperature;
+        if (v == 0.0) {
+            this->target_temperature = UNDEFINED;
+            this->heater_pin.set((this->o = 0));
+        } else {
+            this->set_desired_temperature(v);
+        }
+    }
+
     if (this->temp_violated) {
         this->temp_violated = false;
         THEKERNEL->streams->printf("Error: MINTEMP or MAXTEMP triggered on %s. Check your temperature sensors!\n", designator.c_str());
@@ -310,8 +329,18 @@ void TemperatureControl::on_gcode_received(void *argument)
             }
 
             if(this->active) {
-                // required so temp change happens in order
+                if(gcode->m == this->set_m_code) {
+                    // set in order with the moves by on_gcode_execute, without stopping the moves after it. Which tool is
+                    // active may change before it comes up, so it is marked as ours now
+                    Gcode queued(*gcode);
+                    queued.queued_for = this->name_checksum;
+                    THEKERNEL->conveyor->append_gcode(&queued);
+                    return;
+                }
+
+                // required so temp change happens in order, and before waiting for it to be reached
                 THEKERNEL->conveyor->wait_for_empty_queue();
+                this->applied_count = this->queued_count; // an M104 before it has been overridden
 
                 float v = gcode->get_value('S');
 
@@ -345,6 +374,17 @@ void TemperatureControl::on_gcode_received(void *argument)
     }
 }
 
+// the set temperature M code attached to the queue by on_gcode_received, when we were the active tool. This is usually in the
+// PendSV interrupt, so it only passes the temperature on to the main loop, which sets it up as for any other change
+void TemperatureControl::on_gcode_execute(void *argument)
+{
+    Gcode *gcode = static_cast<Gcode *>(argument);
+    if(!gcode->has_m || gcode->m != this->set_m_code || gcode->queued_for != this->name_checksum) return;
+
+    this->queued_temperature = gcode->get_value('S');
+    this->queued_count = this->queued_count + 1;
+}
+
 void TemperatureControl::on_get_public_data(void *argument)
 {
     PublicDataRequest *pdr = static_cast<PublicDataRequest *>(argument);
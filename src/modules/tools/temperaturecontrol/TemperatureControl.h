@@ -22,6 +22,7 @@ class TemperatureControl : public Module {
         void on_module_loaded();
         void on_main_loop(void* argument);
         void on_gcode_received(void* argument);
+        void on_gcode_execute(void* argument);
         void on_second_tick(void* argument);
         void on_get_public_data(void* argument);
         void on_set_public_data(void* argument);
@@ -57,6 +58,12 @@ class TemperatureControl : public Module {
 
         float readings_per_second;
 
+        // the set temperature of the last M104 that came up in the queue, set in the interrupt that begins its block and taken
+        // by the main loop when queued_count has moved on from applied_count
+        volatile float queued_temperature;
+        volatile uint8_t queued_count;
+        uint8_t applied_count;
+
         uint16_t name_checksum;
 
         Pwm  heater_pin;
@@ -35,6 +35,7 @@ ToolManager::ToolManager()
 void ToolManager::on_module_loaded()
 {
 
+    // a T can be on any line
     this->register_for_event(ON_GCODE_RECEIVED);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
@@ -26,6 +26,7 @@
 #include "PublicData.h"
 #include "LevelingStrategy.h"
 #include "StepTicker.h"
+#include "LoopLatency.h"
 #include "utils.h"
 
 // strategies we know about
@@ -70,7 +71,10 @@ void ZProbe::on_module_loaded()
     // load settings
     this->on_config_reload(this);
     // register event-handlers
-    register_for_event(ON_GCODE_RECEIVED);
+    for (int g : {29, 30, 31, 32, 38})
+        register_for_gcode('G', g);
+    // the leveling strategies can handle any M code
+    register_for_gcode('M');
 
     THEKERNEL->step_ticker->register_acceleration_tick_handler([this](){acceleration_tick(); });
 
@@ -140,6 +144,7 @@ void ZProbe::on_config_reload(void *argument)
 
 bool ZProbe::wait_for_probe(int& steps)
 {
+    BlockingWait wait("probing", __builtin_return_address(0));
     unsigned int debounce = 0;
     while(true) {
         THEKERNEL->call_event(ON_IDLE);
@@ -243,6 +248,7 @@ bool ZProbe::return_probe(int steps, bool reverse)
     }
 
     this->running = true;
+    BlockingWait wait("probe return", __builtin_return_address(0));
     while(STEPPER[Z_AXIS]->is_moving() || (delta && (STEPPER[X_AXIS]->is_moving() || STEPPER[Y_AXIS]->is_moving())) ) {
         // wait for it to complete
         THEKERNEL->call_event(ON_IDLE);
@@ -73,7 +73,8 @@ void CurrentControl::on_module_loaded()
     this->digipot->set_current(7, THEKERNEL->config->value(theta_current_checksum  )->by_default(-1)->as_number());
 
 
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int m : {500, 503, 907})
+        this->register_for_gcode('M', m);
 }
 
 
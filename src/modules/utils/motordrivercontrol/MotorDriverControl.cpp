@@ -168,7 +168,8 @@ bool MotorDriverControl::config_module(uint16_t cs)
         rawreg= false;
     }
 
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int m : {500, 503, 906, 909, 911})
+        this->register_for_gcode('M', m);
     this->register_for_event(ON_HALT);
     this->register_for_event(ON_ENABLE);
     this->register_for_event(ON_IDLE);
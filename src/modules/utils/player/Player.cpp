@@ -64,7 +64,9 @@ void Player::on_module_loaded()
     this->register_for_event(ON_SECOND_TICK);
     this->register_for_event(ON_GET_PUBLIC_DATA);
     this->register_for_event(ON_SET_PUBLIC_DATA);
-    this->register_for_event(ON_GCODE_RECEIVED);
+    this->register_for_gcode('G', 28);
+    for (int m : {21, 23, 24, 25, 26, 27, 32, 600, 601})
+        this->register_for_gcode('M', m);
 
     this->on_boot_gcode = THEKERNEL->config->value(on_boot_gcode_checksum)->by_default("/sd/on_boot.gcode")->as_string();
     this->on_boot_gcode_enable = THEKERNEL->config->value(on_boot_gcode_enable_checksum)->by_default(true)->as_bool();
@@ -401,6 +403,9 @@ void Player::on_main_loop(void *argument)
             return;
         }
 
+        // let the main loop run until the last move has been cut into segments, rather than waiting for it in the next line
+        if(THEKERNEL->robot->has_pending_segments()) return;
+
         char buf[130]; // lines upto 128 characters are allowed, anything longer is discarded
         bool discard = false;
 
@@ -13,6 +13,7 @@
 #include "libs/SerialMessage.h"
 #include "libs/StreamOutput.h"
 #include "modules/robot/Conveyor.h"
+#include "modules/robot/Block.h"
 #include "DirHandle.h"
 #include "mri.h"
 #include "version.h"
@@ -27,7 +28,10 @@
 #include "GcodeDispatch.h"
 #include "BaseSolution.h"
 #include "StepperMotor.h"
+#include "StepTicker.h"
 #include "Configurator.h"
+#include "EventProfiler.h"
+#include "LoopLatency.h"
 
 #include "TemperatureControlPublicAccess.h"
 #include "EndstopsPublicAccess.h"
@@ -83,6 +87,9 @@ const SimpleShell::ptentry_t SimpleShell::commands_table[] = {
     {"calc_thermistor", SimpleShell::calc_thermistor_command},
     {"thermistors", SimpleShell::print_thermistors_command},
     {"md5sum",   SimpleShell::md5sum_command},
+#ifdef EVENT_PROFILE
+    {"profile",  SimpleShell::profile_command},
+#endif
 
     // unknown command
     {NULL, NULL}
@@ -149,7 +156,8 @@ static uint32_t heapWalk(StreamOutput *stream, bool verbose)
 void SimpleShell::on_module_loaded()
 {
     this->register_for_event(ON_CONSOLE_LINE_RECEIVED);
-    this->register_for_event(ON_GCODE_RECEIVED);
+    for (int m : {20, 30, 501, 504})
+        this->register_for_gcode('M', m);
     this->register_for_event(ON_SECOND_TICK);
 
     reset_delay_secs = 0;
@@ -234,6 +242,13 @@ void SimpleShell::on_console_line_received( void *argument )
                 new_message.stream->printf("[Caution: Unlocked]\nok\n");
                 break;
 
+            case 'S':
+                // step interrupt load since the last $S
+                print_isr_stats(new_message.stream);
+                THEKERNEL->step_ticker->reset_isr_stats();
+                new_message.stream->printf("ok\n");
+                break;
+
             case '#':
                 grblDP_command("", new_message.stream);
                 new_message.stream->printf("ok\n");
@@ -579,6 +594,10 @@ void SimpleShell::mem_command( string parameters, StreamOutput *stream)
     stream->printf("Total Free RAM: %lu bytes\r\n", m + f);
 
     stream->printf("Free AHB0: %lu, AHB1: %lu\r\n", AHB0.free(), AHB1.free());
+
+    unsigned int queue_size= THEKERNEL->conveyor->get_queue_size();
+    stream->printf("Planner queue: %u blocks of %u bytes (%u bytes), %u attached gcodes allocated\r\n",
+        queue_size, sizeof(Block), queue_size * sizeof(Block), Block::get_gcode_pool_size());
     if (verbose) {
         AHB0.debug(stream);
         AHB1.debug(stream);
@@ -821,11 +840,66 @@ void SimpleShell::get_command( string parameters, StreamOutput *stream)
         // also ? on serial and usb
         stream->printf("%s\n", THEKERNEL->get_query_string().c_str());
 
+    } else if (what == "amass") {
+        // how many step interrupts there have been against running all the time at the finest step smoothing level
+        uint64_t interrupts, finest_ticks;
+        THEKERNEL->step_ticker->get_amass_stats(interrupts, finest_ticks);
+        uint8_t max_level= THEKERNEL->step_ticker->get_amass_max_level();
+        stream->printf("AMASS level %d of %d, %1.0f step interrupts where %1.0f ticks at %1.0fHz would be, %1.1f%% saved\n",
+            THEKERNEL->step_ticker->get_amass_level(), max_level, (double)interrupts, (double)finest_ticks,
+            THEKERNEL->step_ticker->get_frequency() * (1 << max_level),
+            finest_ticks > 0 ? 100.0F - 100.0F * interrupts / finest_ticks : 0.0F);
+
+    } else if (what == "isr") {
+        // the load the step interrupts put on the CPU since the last reset, "get isr reset" starts again
+        print_isr_stats(stream);
+        if(shift_parameter(parameters) == "reset") THEKERNEL->step_ticker->reset_isr_stats();
+
+    } else if (what == "latency") {
+        // how long the main loop takes to go round and the longest waits that held it up, "get latency reset" starts again
+        THEKERNEL->loop_latency->print(stream);
+        if(shift_parameter(parameters) == "reset") THEKERNEL->loop_latency->reset();
+
     } else {
         stream->printf("error:unknown option %s\n", what.c_str());
     }
 }
 
+#ifdef EVENT_PROFILE
+// print how long the modules have taken handling events, "profile reset" also starts again
+void SimpleShell::profile_command( string parameters, StreamOutput *stream)
+{
+    THEKERNEL->event_profiler->print(stream);
+    if(shift_parameter(parameters) == "reset") THEKERNEL->event_profiler->reset();
+}
+#endif
+
+// For each step interrupt the percentage of the CPU it took, the longest it ran, and the earliest and latest it started
+// after it was due, the difference between those being the jitter of the steps
+void SimpleShell::print_isr_stats(StreamOutput *stream)
+{
+    static const char *names[StepTicker::NUMBER_OF_ISRS]= {"step TIMER0", "unstep TIMER1", "end of move PendSV", "acceleration RIT"};
+    StepTicker::isr_stats_t stats[StepTicker::NUMBER_OF_ISRS];
+    uint32_t elapsed_us;
+    THEKERNEL->step_ticker->get_isr_stats(stats, elapsed_us);
+    if(elapsed_us == 0) elapsed_us= 1;
+
+    float cycles_per_us= SystemCoreClock / 1000000.0F;
+    float total= 0;
+    for (int i = 0; i < StepTicker::NUMBER_OF_ISRS; i++) {
+        const StepTicker::isr_stats_t& s= stats[i];
+        float cpu= s.cycles / cycles_per_us * 100.0F / elapsed_us;
+        total += cpu;
+        if(s.count == 0) {
+            stream->printf("%s: none\n", names[i]);
+            continue;
+        }
+        stream->printf("%s: %lu, %1.2f%% cpu, max %1.2f us, latency %1.2f - %1.2f us, jitter %1.2f us\n", names[i], s.count, cpu,
+                       s.max_cycles / cycles_per_us, s.min_latency / cycles_per_us, s.max_latency / cycles_per_us, (s.max_latency - s.min_latency) / cycles_per_us);
+    }
+    stream->printf("total %1.2f%% cpu over %1.3f s\n", total, elapsed_us / 1000000.0F);
+}
+
 // used to test out the get public data events
 void SimpleShell::set_temp_command( string parameters, StreamOutput *stream)
 {
@@ -947,7 +1021,7 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("break - break into debugger\r\n");
     stream->printf("config-get [<configuration_source>] <configuration_setting>\r\n");
     stream->printf("config-set [<configuration_source>] <configuration_setting> <value>\r\n");
-    stream->printf("get [pos|wcs|state|status|fk|ik]\r\n");
+    stream->printf("get [pos|wcs|state|status|fk|ik|amass|isr|latency]\r\n");
     stream->printf("get temp [bed|hotend]\r\n");
     stream->printf("set_temp bed|hotend 185\r\n");
     stream->printf("net\r\n");
@@ -957,5 +1031,8 @@ void SimpleShell::help_command( string parameters, StreamOutput *stream )
     stream->printf("calc_thermistor [-s0] T1,R1,T2,R2,T3,R3 - calculate the Steinhart Hart coefficients for a thermistor\r\n");
     stream->printf("thermistors - print out the predefined thermistors\r\n");
     stream->printf("md5sum file - prints md5 sum of the given file\r\n");
+#ifdef EVENT_PROFILE
+    stream->printf("profile [reset] - time taken by each module on each event, reset starts again\r\n");
+#endif
 }
 
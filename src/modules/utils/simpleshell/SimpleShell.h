@@ -30,6 +30,7 @@ public:
     static void print_mem(StreamOutput *stream) { mem_command("", stream); }
 
 private:
+    static void print_isr_stats(StreamOutput *stream);
     static void ls_command(string parameters, StreamOutput *stream );
     static void cd_command(string parameters, StreamOutput *stream );
     static void delete_file_command(string parameters, StreamOutput *stream );
@@ -60,6 +61,10 @@ private:
 
     static void remount_command( string parameters, StreamOutput *stream);
 
+#ifdef EVENT_PROFILE
+    static void profile_command( string parameters, StreamOutput *stream);
+#endif
+
 
     typedef void (*PFUNC)(string parameters, StreamOutput *stream);
     typedef struct {
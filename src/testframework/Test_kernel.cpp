@@ -21,6 +21,7 @@ This is aprt of the Smoothie test framework, it generates a Mockable Kernl so ke
 #include "ConfigValue.h"
 
 #include "libs/StepTicker.h"
+#include "libs/LoopLatency.h"
 #include "libs/PublicData.h"
 #include "modules/communication/SerialConsole.h"
 #include "modules/communication/GcodeDispatch.h"
@@ -57,6 +58,7 @@ Kernel::Kernel(){
     this->current_path   = "/";
 
     this->slow_ticker = new SlowTicker();
+    this->loop_latency = new LoopLatency();
 
     // dummies (would be nice to refactor to not have to create a conveyor)
     this->conveyor= new Conveyor();
@@ -74,13 +76,26 @@ void Kernel::add_module(Module* module){
 
 // Adds a hook for a given module and event
 void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
+    if(id_event == ON_GCODE_RECEIVED) {
+        // every line
+        this->gcode_handlers.add_all(mod);
+        return;
+    }
     this->hooks[id_event].push_back(mod);
 }
 
+// Adds a module to the ones a G or M code is sent to on ON_GCODE_RECEIVED
+void Kernel::register_for_gcode(char letter, int code, Module *mod){
+    this->gcode_handlers.add(letter, code, mod);
+}
+
 static std::map<_EVENT_ENUM, std::function<void(void*)> > event_callbacks;
 
 // Call a specific event with an argument
 void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    if(id_event == ON_GCODE_RECEIVED) {
+        this->gcode_handlers.dispatch(static_cast<Gcode *>(argument));
+    }
     for (auto m : hooks[id_event]) {
         (m->*kernel_callback_functions[id_event])(argument);
     }
@@ -94,6 +109,7 @@ void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
 // These are used by tests to test for various things. basically mocks
 bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) return this->gcode_handlers.contains(mod);
     for (auto m : hooks[id_event]) {
         if(m == mod) return true;
     }
@@ -102,6 +118,10 @@ bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
 
 void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
 {
+    if(id_event == ON_GCODE_RECEIVED) {
+        this->gcode_handlers.remove(mod);
+        return;
+    }
     for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
         if(*i == mod) {
             hooks[id_event].erase(i);
@@ -0,0 +1,174 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Gcode dispatch benchmark for the host build.
+
+Times sending each line of G-code files to the modules of a fully loaded 3D printer build, once with every module getting
+every line as ON_GCODE_RECEIVED did before modules registered for their G and M codes, and once through GcodeHandlers with
+each module registered for the codes the real one registers for. The modules only check the line is one of theirs, so the
+times are the cost of the dispatch itself.
+
+Usage: dispatch_bench [-n rounds] file.gcode ...
+*/
+
+#include "libs/GcodeHandlers.h"
+#include "libs/Module.h"
+#include "Gcode.h"
+
+#include <chrono>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+// Stands in for a module, handles its codes like the real one by testing has_g/has_m and the number
+class BenchModule : public Module {
+    public:
+        BenchModule(std::initializer_list<int> g, std::initializer_list<int> m, bool any_g= false, bool any_m= false, bool any_line= false)
+            : g_codes(g), m_codes(m), all_g(any_g), all_m(any_m), all_lines(any_line), calls(0), handled(0) {}
+
+        void on_gcode_received(void *argument)
+        {
+            Gcode *gcode= static_cast<Gcode *>(argument);
+            calls++;
+            if(all_lines || (gcode->has_g && (all_g || has(g_codes, gcode->g))) || (gcode->has_m && (all_m || has(m_codes, gcode->m)))) handled++;
+        }
+
+        void register_with(GcodeHandlers &direct, GcodeHandlers &broadcast)
+        {
+            broadcast.add_all(this);
+            if(all_lines) {
+                direct.add_all(this);
+                return;
+            }
+            if(all_g) direct.add('G', -1, this);
+            if(all_m) direct.add('M', -1, this);
+            for (int g : g_codes) direct.add('G', g, this);
+            for (int m : m_codes) direct.add('M', m, this);
+        }
+
+        std::vector<int> g_codes, m_codes;
+        bool all_g, all_m, all_lines;
+        uint64_t calls, handled;
+
+    private:
+        static bool has(const std::vector<int> &codes, unsigned int code)
+        {
+            for (int c : codes) if(c == (int)code) return true;
+            return false;
+        }
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n rounds] file.gcode ...\n", prog);
+    fprintf(stderr, "  -n rounds   number of times to dispatch each file, default 10\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds= 10;
+    int c;
+    while((c= getopt(argc, argv, "n:h")) != -1) {
+        switch(c) {
+            case 'n': rounds= atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc || rounds < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // the modules in the order main() loads them, with two extruders and hotends, a bed, four switches and a Z probe
+    std::vector<BenchModule *> modules= {
+        new BenchModule({}, {0, 2, 30, 92, 114, 120, 121, 203, 204, 205, 220, 400, 500, 503, 665}, true),   // Robot
+        new BenchModule({}, {17, 18, 84}),                                                                      // Stepper
+        new BenchModule({}, {20, 30, 501, 504}),                                                                // SimpleShell
+        new BenchModule({28}, {21, 23, 24, 25, 26, 27, 32, 600, 601}),                                          // Player
+        new BenchModule({28}, {119, 206, 306, 500, 503, 665, 666, 1910}),                                       // Endstops
+        new BenchModule({0, 1, 2, 3, 10, 11, 90, 91, 92}, {17, 18, 82, 83, 84, 92, 114, 200, 203, 204, 207, 208, 221, 500, 503, 900}), // Extruder
+        new BenchModule({0, 1, 2, 3, 10, 11, 90, 91, 92}, {17, 18, 82, 83, 84, 92, 114, 200, 203, 204, 207, 208, 221, 500, 503, 900}), // Extruder
+        new BenchModule({}, {}, false, false, true),                                                            // ToolManager
+        new BenchModule({}, {104, 109, 105, 143, 301, 305, 500, 503}),                                          // TemperatureControl hotend
+        new BenchModule({}, {104, 109, 105, 143, 301, 305, 500, 503}),                                          // TemperatureControl hotend2
+        new BenchModule({}, {140, 190, 105, 143, 301, 305, 500, 503}),                                          // TemperatureControl bed
+        new BenchModule({}, {106, 107}),                                                                        // Switch fan
+        new BenchModule({}, {42, 43}),                                                                          // Switch
+        new BenchModule({}, {80, 81}),                                                                          // Switch psu
+        new BenchModule({}, {280, 281}),                                                                        // Switch servo
+        new BenchModule({29, 30, 31, 32, 38}, {}, false, true),                                                 // ZProbe
+        new BenchModule({}, {303, 304}),                                                                        // PID_Autotuner
+        new BenchModule({}, {404, 405, 406, 407}),                                                              // FilamentDetector
+        new BenchModule({}, {500, 503, 907}),                                                                   // CurrentControl
+    };
+    GcodeHandlers direct, broadcast;
+    for (auto m : modules) m->register_with(direct, broadcast);
+
+    int ret= 0;
+    for (int f = optind; f < argc; ++f) {
+        FILE *fp= fopen(argv[f], "r");
+        if(fp == NULL) {
+            fprintf(stderr, "Unable to open %s\n", argv[f]);
+            ret= 1;
+            continue;
+        }
+
+        std::vector<Gcode *> gcodes;
+        char buf[256];
+        while(fgets(buf, sizeof(buf), fp) != NULL) {
+            std::string line(buf);
+            size_t comment= line.find_first_of(";(\r\n");
+            if(comment != std::string::npos) line= line.substr(0, comment);
+            if(line.empty()) continue;
+            gcodes.push_back(new Gcode(line, nullptr));
+        }
+        fclose(fp);
+        if(gcodes.empty()) continue;
+
+        uint64_t ns[2], calls[2], handled[2];
+        GcodeHandlers *tables[2]= { &broadcast, &direct };
+        for (int t = 0; t < 2; ++t) {
+            for (auto m : modules) m->calls= m->handled= 0;
+            uint64_t t0= now_ns();
+            for (int r = 0; r < rounds; ++r) {
+                for (auto g : gcodes) tables[t]->dispatch(g);
+            }
+            ns[t]= now_ns() - t0;
+            calls[t]= handled[t]= 0;
+            for (auto m : modules) {
+                calls[t] += m->calls;
+                handled[t] += m->handled;
+            }
+        }
+
+        double n= (double)gcodes.size() * rounds;
+        printf("%s\n", argv[f]);
+        printf("  lines: %lu, rounds: %d, modules: %lu\n", (unsigned long)gcodes.size(), rounds, (unsigned long)modules.size());
+        printf("  every module:   %7.1f ns per line, %5.2f calls per line\n", ns[0] / n, calls[0] / n);
+        printf("  registered:     %7.1f ns per line, %5.2f calls per line\n", ns[1] / n, calls[1] / n);
+        if(handled[0] != handled[1]) {
+            printf("FAIL: %llu lines handled by every module, %llu by the registered ones\n", (unsigned long long)handled[0], (unsigned long long)handled[1]);
+            ret= 1;
+        }
+
+        for (auto g : gcodes) delete g;
+    }
+
+    return ret;
+}
@@ -0,0 +1,199 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Accuracy and speed test of libs/FastMath.h for the host build.
+
+First compares each approximation with libm over its whole domain, printing the largest error and the time per call of
+both. Then sweeps the actuators of the rotary delta and the Morgan SCARA arm solutions over their range, converts each
+position to cartesian with the forward kinematics, and converts that back with the inverse kinematics both with and
+without arm_fast_math. The largest difference is printed in actuator units and in microsteps of the actuators in the
+config, and the test fails if it is a microstep or more.
+
+Usage: fastmath_test [-c config]
+*/
+
+#include "HostKernel.h"
+
+#include "libs/Kernel.h"
+#include "libs/Config.h"
+#include "libs/FastMath.h"
+#include "libs/StepperMotor.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/arm_solutions/BaseSolution.h"
+#include "modules/robot/arm_solutions/RotaryDeltaSolution.h"
+#include "modules/robot/arm_solutions/MorganSCARASolution.h"
+#include "ActuatorCoordinates.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+static volatile float sink; // keeps the timed calls from being optimised away
+
+// times f over the inputs and returns the mean ns per call
+template <typename F>
+static double time_per_call(const std::vector<float>& in, F f)
+{
+    const int rounds= 20;
+    float sum= 0;
+    uint64_t start= now_ns();
+    for (int r = 0; r < rounds; ++r) {
+        for (size_t i = 0; i + 1 < in.size(); ++i) {
+            sum += f(in[i], in[i + 1]);
+        }
+    }
+    uint64_t elapsed= now_ns() - start;
+    sink= sum;
+    return (double)elapsed / rounds / (in.size() - 1);
+}
+
+static void test_functions()
+{
+    // atanf over the whole line, spread evenly over the angle
+    std::vector<float> tangents;
+    for (int i = -500000; i <= 500000; ++i) {
+        tangents.push_back(tanf(i * 1.5707963F / 500001));
+    }
+    double atan_err= 0;
+    for (float x : tangents) atan_err= fmax(atan_err, fabs((double)fast_atanf(x) - atan((double)x)));
+
+    // atan2f all round the circle at radii from 1E-3 to 1E3
+    std::vector<float> coords;
+    double atan2_err= 0;
+    for (int r = -3; r <= 3; ++r) {
+        float radius= powf(10, r);
+        for (int i = 0; i < 100000; ++i) {
+            float theta= i * 6.2831853F / 100000;
+            float y= radius * sinf(theta), x= radius * cosf(theta);
+            coords.push_back(y); coords.push_back(x);
+            atan2_err= fmax(atan2_err, fabs((double)fast_atan2f(y, x) - atan2((double)y, (double)x)));
+        }
+    }
+
+    printf("functions:\n");
+    printf("  atanf:  largest error %1.2e rad, libm %6.2f ns, fast %6.2f ns\n", atan_err,
+        time_per_call(tangents, [](float a, float b) { return atanf(a); }), time_per_call(tangents, [](float a, float b) { return fast_atanf(a); }));
+    printf("  atan2f: largest error %1.2e rad, libm %6.2f ns, fast %6.2f ns\n", atan2_err,
+        time_per_call(coords, [](float a, float b) { return atan2f(a, b); }), time_per_call(coords, [](float a, float b) { return fast_atan2f(a, b); }));
+}
+
+// converts the positions with both solutions, prints the largest difference and returns it in microsteps
+static float test_solution(const char *name, BaseSolution *libm, BaseSolution *fast, const std::vector<float>& points)
+{
+    size_t n= points.size() / 3;
+    const float (*cartesian)[3]= reinterpret_cast<const float (*)[3]>(points.data());
+    std::vector<ActuatorCoordinates> a(n), b(n);
+
+    uint64_t start= now_ns();
+    libm->cartesian_to_actuators(cartesian, a.data(), n);
+    uint64_t libm_ns= now_ns() - start;
+    start= now_ns();
+    fast->cartesian_to_actuators(cartesian, b.data(), n);
+    uint64_t fast_ns= now_ns() - start;
+
+    float worst= 0, worst_steps= 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t j = 0; j < 3; ++j) {
+            float d= fabsf(a[i][j] - b[i][j]);
+            float steps= d * THEKERNEL->robot->actuators[j]->get_steps_per_mm();
+            if(!(d <= worst)) worst= d;
+            if(!(steps <= worst_steps)) worst_steps= steps;
+        }
+    }
+
+    printf("  %-13s %7lu positions, largest difference %1.2e (%1.3f microsteps), libm %6.2f ns, fast %6.2f ns per position\n",
+        name, (unsigned long)n, worst, worst_steps, (double)libm_ns / n, (double)fast_ns / n);
+    return worst_steps;
+}
+
+// the cartesian positions the actuators reach when each of them is swept from min to max
+static std::vector<float> sweep(BaseSolution *solution, float min[3], float max[3], float step[3])
+{
+    std::vector<float> points;
+    ActuatorCoordinates actuator{};
+    for (actuator[0] = min[0]; actuator[0] <= max[0]; actuator[0] += step[0]) {
+        for (actuator[1] = min[1]; actuator[1] <= max[1]; actuator[1] += step[1]) {
+            for (actuator[2] = min[2]; actuator[2] <= max[2]; actuator[2] += step[2]) {
+                float cartesian[3];
+                solution->actuator_to_cartesian(actuator, cartesian);
+                if(isfinite(cartesian[0]) && isfinite(cartesian[1]) && isfinite(cartesian[2])) {
+                    points.insert(points.end(), cartesian, cartesian + 3);
+                }
+            }
+        }
+    }
+    return points;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config]\n", prog);
+    fprintf(stderr, "  -c config   use this config file instead of the built in config.default, its steps_per_mm are used as the\n");
+    fprintf(stderr, "              microsteps per degree of the arm solutions\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int c;
+    while((c= getopt(argc, argv, "c:h")) != -1) {
+        switch(c) {
+            case 'c': host_kernel_set_config_file(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+
+    test_functions();
+
+    // make one of each solution with libm and one with the approximations
+    host_kernel_set_config_value("arm_fast_math", "false");
+    new Kernel();
+    Config *config= THEKERNEL->config;
+    BaseSolution *rotary= new RotaryDeltaSolution(config);
+    BaseSolution *scara= new MorganSCARASolution(config);
+
+    host_kernel_set_config_value("arm_fast_math", "true");
+    config->config_cache_load();
+    BaseSolution *rotary_fast= new RotaryDeltaSolution(config);
+    BaseSolution *scara_fast= new MorganSCARASolution(config);
+
+    printf("inverse kinematics:\n");
+
+    // the three arms from straight up to straight down
+    float rotary_min[3]= {-90, -90, -90}, rotary_max[3]= {90, 90, 90}, rotary_step[3]= {2, 2, 2};
+    float worst= test_solution("rotary delta", rotary, rotary_fast, sweep(rotary, rotary_min, rotary_max, rotary_step));
+
+    // the inner arm all the way round, the outer arm relative to it up to where morgan_undefined_min and max stop it
+    std::vector<float> scara_points;
+    for (float theta = -180; theta < 180; theta += 0.5F) {
+        for (float psi = 20; psi <= 160; psi += 0.5F) {
+            for (float z = 0; z <= 100; z += 50) {
+                ActuatorCoordinates actuator{theta, theta + psi, z};
+                float cartesian[3];
+                scara->actuator_to_cartesian(actuator, cartesian);
+                scara_points.insert(scara_points.end(), cartesian, cartesian + 3);
+            }
+        }
+    }
+    worst= fmaxf(worst, test_solution("morgan scara", scara, scara_fast, scara_points));
+
+    if(worst >= 1.0F) {
+        printf("FAIL: arm_fast_math is a microstep or more away from libm\n");
+        return 1;
+    }
+    printf("PASS: arm_fast_math is within %1.3f microsteps of libm\n", worst);
+    return 0;
+}
@@ -0,0 +1,111 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Gcode parse benchmark for the host build.
+
+Reads G-code files into memory and times, per line, constructing a Gcode from it, the letter lookups Robot does for a
+move, and the copy made when a Gcode is attached to a block. Comments and blank lines are skipped like GcodeDispatch does.
+
+Usage: gcode_bench [-n rounds] file.gcode ...
+*/
+
+#include "Gcode.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+// the lookups are added up in here so they are not optimized away
+static volatile float sink;
+
+static inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n rounds] file.gcode ...\n", prog);
+    fprintf(stderr, "  -n rounds   number of times to parse each file, default 10\n");
+}
+
+int main(int argc, char *argv[])
+{
+    int rounds= 10;
+    int c;
+    while((c= getopt(argc, argv, "n:h")) != -1) {
+        switch(c) {
+            case 'n': rounds= atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc || rounds < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int ret= 0;
+    for (int f = optind; f < argc; ++f) {
+        FILE *fp= fopen(argv[f], "r");
+        if(fp == NULL) {
+            fprintf(stderr, "Unable to open %s\n", argv[f]);
+            ret= 1;
+            continue;
+        }
+
+        std::vector<string> lines;
+        char buf[256];
+        while(fgets(buf, sizeof(buf), fp) != NULL) {
+            string line(buf);
+            size_t comment= line.find_first_of(";(\r\n");
+            if(comment != string::npos) line= line.substr(0, comment);
+            if(line.empty()) continue;
+            lines.push_back(line);
+        }
+        fclose(fp);
+        if(lines.empty()) continue;
+
+        uint64_t parse= 0, lookup= 0, copy= 0;
+        float sum= 0;
+        for (int r = 0; r < rounds; ++r) {
+            for(auto& line : lines) {
+                uint64_t t0= now_ns();
+                Gcode gcode(line, nullptr);
+                uint64_t t1= now_ns();
+                for(char letter : {'X', 'Y', 'Z', 'E', 'F'}) {
+                    if(gcode.has_letter(letter)) sum += gcode.get_value(letter);
+                }
+                uint64_t t2= now_ns();
+                {
+                    Gcode attached(gcode);
+                    attached.strip_parameters();
+                    sum += attached.g;
+                }
+                uint64_t t3= now_ns();
+                parse += t1 - t0;
+                lookup += t2 - t1;
+                copy += t3 - t2;
+            }
+        }
+
+        sink= sum;
+
+        double n= (double)lines.size() * rounds;
+        printf("%s\n", argv[f]);
+        printf("  lines: %lu, rounds: %d\n", (unsigned long)lines.size(), rounds);
+        printf("  per line: parse %1.1f ns, XYZEF lookups %1.1f ns, attach copy %1.1f ns\n", parse / n, lookup / n, copy / n);
+    }
+
+    return ret;
+}
@@ -0,0 +1,266 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+This is part of the Smoothie host build, it provides the memory behind the fake LPC17xx peripherals and the handful of mbed/MRI
+calls the motion core makes, so it can be linked into a normal Linux executable.
+
+It can also emulate the timers the StepTicker uses, see host_hal_run(), so the real step generation can be simulated
+*/
+
+#include "HostHal.h"
+#include "system_LPC17xx.h"
+#include "us_ticker_api.h"
+#include "wait_api.h"
+#include "MRI_Hooks.h"
+
+#include <chrono>
+#include <thread>
+#include <bitset>
+#include <stdlib.h>
+#include <algorithm>
+
+uint32_t SystemCoreClock= 100000000;
+
+LPC_GPIO_TypeDef host_lpc_gpio[5];
+LPC_TIM_TypeDef  host_lpc_tim[4];
+LPC_RIT_TypeDef  host_lpc_rit;
+LPC_SC_TypeDef   host_lpc_sc;
+LPC_WDT_TypeDef  host_lpc_wdt;
+SCB_Type         host_scb;
+DWT_Type         host_dwt;
+CoreDebug_Type   host_coredebug;
+
+host_cyccnt_reg::operator uint32_t() const
+{
+    uint64_t ns= std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    return ns * (SystemCoreClock / 1000000) / 1000;
+}
+
+static std::bitset<HOST_NUMBER_OF_IRQn> irq_enabled;
+static std::bitset<HOST_NUMBER_OF_IRQn> irq_pending;
+static uint32_t irq_priority[HOST_NUMBER_OF_IRQn];
+static uint32_t pendsv_priority;
+
+// system exceptions have negative numbers, they are never enabled or pended through the NVIC
+static inline bool is_nvic_irq(IRQn_Type IRQn) { return IRQn >= 0 && IRQn < HOST_NUMBER_OF_IRQn; }
+
+extern "C" {
+
+void NVIC_SetPriorityGrouping(uint32_t PriorityGroup) {}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    if(is_nvic_irq(IRQn)) irq_enabled[IRQn]= true;
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    if(is_nvic_irq(IRQn)) irq_enabled[IRQn]= false;
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    return is_nvic_irq(IRQn) && irq_pending[IRQn] ? 1 : 0;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    if(is_nvic_irq(IRQn)) irq_pending[IRQn]= true;
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    if(is_nvic_irq(IRQn)) irq_pending[IRQn]= false;
+}
+
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    if(is_nvic_irq(IRQn)) irq_priority[IRQn]= priority;
+    else if(IRQn == PendSV_IRQn) pendsv_priority= priority;
+}
+
+uint32_t NVIC_GetPriority(IRQn_Type IRQn)
+{
+    if(IRQn == PendSV_IRQn) return pendsv_priority;
+    return is_nvic_irq(IRQn) ? irq_priority[IRQn] : 0;
+}
+
+void NVIC_SystemReset(void)
+{
+    exit(0);
+}
+
+// microseconds since the first call, wraps like the real us ticker
+uint32_t us_ticker_read(void)
+{
+    static const auto start= std::chrono::steady_clock::now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+void wait(float s)
+{
+    wait_us(s * 1000000.0F);
+}
+
+void wait_ms(int ms)
+{
+    wait_us(ms * 1000);
+}
+
+void wait_us(int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void set_high_on_debug(int port, int pin) {}
+void set_low_on_debug(int port, int pin) {}
+
+}
+
+// the handlers in StepTicker.cpp
+extern "C" void TIMER0_IRQHandler(void);
+extern "C" void TIMER1_IRQHandler(void);
+extern "C" void RIT_IRQHandler(void);
+extern "C" void PendSV_Handler(void);
+
+static uint64_t now;
+static std::function<void(IRQn_Type)> before_irq_hook;
+static std::function<void(IRQn_Type)> after_irq_hook;
+
+static const uint64_t never= UINT64_MAX;
+static const uint32_t timer_clock_divider= 4; // the timers run at SystemCoreClock/4, the RIT at SystemCoreClock
+
+uint64_t host_hal_now()
+{
+    return now;
+}
+
+void host_hal_set_irq_hooks(std::function<void(IRQn_Type)> before, std::function<void(IRQn_Type)> after)
+{
+    before_irq_hook= before;
+    after_irq_hook= after;
+}
+
+// number of counts until the counter equals the match value, when reset on match it goes from match back to 0
+static uint64_t counts_to_match(uint32_t counter, uint32_t match, bool reset_on_match)
+{
+    if(reset_on_match && counter == match) return (uint64_t)match + 1;
+    uint32_t n= match - counter;
+    return n == 0 ? (1ULL << 32) : n;
+}
+
+// advance a counter by n counts, n never goes past the next match
+static uint32_t count(uint32_t counter, uint32_t match, bool reset_on_match, uint64_t n)
+{
+    if(n == 0) return counter;
+    if(reset_on_match && counter == match) return n - 1;
+    return counter + n;
+}
+
+static bool timer_running(LPC_TIM_TypeDef *tim)
+{
+    return (tim->TCR & 3) == 1;
+}
+
+// when the timer next matches MR0, in core cycles
+static uint64_t timer_next_match(LPC_TIM_TypeDef *tim)
+{
+    if(!timer_running(tim)) return never;
+    uint64_t n= counts_to_match(tim->TC, tim->MR0, tim->MCR & 2);
+    return (now / timer_clock_divider + n) * timer_clock_divider;
+}
+
+static void timer_advance(LPC_TIM_TypeDef *tim, IRQn_Type irq, uint64_t to)
+{
+    if(!timer_running(tim)) return;
+    uint64_t n= to / timer_clock_divider - now / timer_clock_divider;
+    tim->TC= count(tim->TC, tim->MR0, tim->MCR & 2, n);
+    if(n > 0 && tim->TC == tim->MR0) {
+        tim->IR |= 1;
+        if(tim->MCR & 1) irq_pending[irq]= true;
+    }
+}
+
+static bool rit_running()
+{
+    return (LPC_RIT->RICTRL & 8) != 0;
+}
+
+static uint64_t rit_next_match()
+{
+    if(!rit_running()) return never;
+    return now + counts_to_match(LPC_RIT->RICOUNTER, LPC_RIT->RICOMPVAL, LPC_RIT->RICTRL & 2);
+}
+
+static void rit_advance(uint64_t to)
+{
+    if(!rit_running()) return;
+    uint64_t n= to - now;
+    LPC_RIT->RICOUNTER= count(LPC_RIT->RICOUNTER, LPC_RIT->RICOMPVAL, LPC_RIT->RICTRL & 2, n);
+    if(n > 0 && LPC_RIT->RICOUNTER == LPC_RIT->RICOMPVAL) {
+        LPC_RIT->RICTRL |= 1;
+        irq_pending[RIT_IRQn]= true;
+    }
+}
+
+static void call_handler(IRQn_Type irq)
+{
+    if(before_irq_hook) before_irq_hook(irq);
+    switch(irq) {
+        case TIMER0_IRQn: TIMER0_IRQHandler(); break;
+        case TIMER1_IRQn: TIMER1_IRQHandler(); break;
+        case RIT_IRQn:    RIT_IRQHandler(); break;
+        case PendSV_IRQn: PendSV_Handler(); break;
+        default: break;
+    }
+    if(after_irq_hook) after_irq_hook(irq);
+}
+
+// run the pending interrupts, lowest priority value first, and PendSV before an interrupt of the same priority
+static void run_pending()
+{
+    for(;;) {
+        int best= HOST_NUMBER_OF_IRQn;
+        uint32_t best_priority= UINT32_MAX;
+        if(SCB->ICSR & SCB_ICSR_PENDSVSET_Msk) {
+            best= PendSV_IRQn;
+            best_priority= pendsv_priority;
+        }
+        for (int i = 0; i < HOST_NUMBER_OF_IRQn; ++i) {
+            if(irq_pending[i] && irq_enabled[i] && irq_priority[i] < best_priority) {
+                best= i;
+                best_priority= irq_priority[i];
+            }
+        }
+        if(best == HOST_NUMBER_OF_IRQn) return;
+
+        if(best == PendSV_IRQn) SCB->ICSR &= ~SCB_ICSR_PENDSVSET_Msk;
+        else irq_pending[best]= false;
+        call_handler((IRQn_Type)best);
+    }
+}
+
+void host_hal_run(uint64_t cycles)
+{
+    uint64_t end= now + cycles;
+    for(;;) {
+        // anything the main loop pended runs first
+        run_pending();
+
+        uint64_t next= std::min(std::min(timer_next_match(LPC_TIM0), timer_next_match(LPC_TIM1)), rit_next_match());
+        if(next > end) next= end;
+
+        timer_advance(LPC_TIM0, TIMER0_IRQn, next);
+        timer_advance(LPC_TIM1, TIMER1_IRQn, next);
+        rit_advance(next);
+        now= next;
+
+        run_pending();
+        if(now == end) return;
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "libs/LPC17xx/sLPC17xx.h"
+
+#include <functional>
+#include <stdint.h>
+
+// Emulated time, in core clock cycles since the start
+uint64_t host_hal_now();
+
+// Advance the emulated time by the given number of core clock cycles, counting TIMER0, TIMER1 and the RIT the way the
+// firmware configured them and running TIMER0_IRQHandler, TIMER1_IRQHandler, RIT_IRQHandler and PendSV_Handler when
+// they are enabled and due, highest priority first. Handlers take no emulated time so they never nest.
+void host_hal_run(uint64_t cycles);
+
+// Called before and after every interrupt handler host_hal_run() runs
+void host_hal_set_irq_hooks(std::function<void(IRQn_Type)> before, std::function<void(IRQn_Type)> after);
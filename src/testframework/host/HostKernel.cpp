@@ -0,0 +1,245 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+This is part of the Smoothie host build, it is a Kernel that only loads the motion core (Robot, Conveyor, Planner) so
+G-code can be run through it on a PC. The StepTicker is created so the actuators can register with it, but as there are no
+real timers nothing steps unless a host tool adds the Stepper module and drives the emulated timers with host_hal_run().
+*/
+
+#include "HostKernel.h"
+
+#include "libs/Kernel.h"
+#include "libs/LPC17xx/sLPC17xx.h"
+#include "libs/Module.h"
+#include "libs/Config.h"
+#include "libs/StreamOutputPool.h"
+#include "libs/StepTicker.h"
+#include "libs/LoopLatency.h"
+#include "libs/ConfigSources/FileConfigSource.h"
+#include "libs/ConfigSources/FirmConfigSource.h"
+#include "libs/ConfigSource.h"
+#include "modules/robot/Planner.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/Conveyor.h"
+#include "Gcode.h"
+#include "checksumm.h"
+#include "ConfigValue.h"
+
+#include <string>
+#include <vector>
+
+#define base_stepping_frequency_checksum            CHECKSUM("base_stepping_frequency")
+#define microseconds_per_step_pulse_checksum        CHECKSUM("microseconds_per_step_pulse")
+#define acceleration_ticks_per_second_checksum      CHECKSUM("acceleration_ticks_per_second")
+#define event_driven_stepping_checksum              CHECKSUM("event_driven_stepping")
+#define amass_max_level_checksum                    CHECKSUM("amass_max_level")
+#define grbl_mode_checksum                          CHECKSUM("grbl_mode")
+#define ok_per_line_checksum                        CHECKSUM("ok_per_line")
+
+Kernel* Kernel::instance;
+
+static std::string config_file;
+static std::vector<std::string> config_overrides;
+static StdoutStreamOutput stdout_stream;
+
+void host_kernel_set_config_file(const char *filename)
+{
+    config_file= filename;
+}
+
+void host_kernel_set_config_value(const char *setting, const char *value)
+{
+    config_overrides.push_back(std::string(setting) + " " + value);
+}
+
+// Reads the config from another source then replaces the values that were overridden
+class OverrideConfigSource : public ConfigSource {
+    public:
+        OverrideConfigSource(ConfigSource *source) : source(source) {}
+        ~OverrideConfigSource() { delete source; }
+
+        void transfer_values_to_cache( ConfigCache *cache )
+        {
+            source->transfer_values_to_cache(cache);
+            for (auto& line : config_overrides) {
+                process_line_from_ascii_config(line, cache);
+            }
+        }
+        bool is_named( uint16_t check_sum ) { return source->is_named(check_sum); }
+        bool write( string setting, string value ) { return false; }
+        string read( uint16_t check_sums[3] ) { return source->read(check_sums); }
+
+    private:
+        ConfigSource *source;
+};
+
+Kernel::Kernel(){
+    halted= false;
+    feed_hold= false;
+    use_leds= false;
+
+    instance= this; // setup the Singleton instance of the kernel
+
+    this->serial = nullptr;
+    this->slow_ticker = nullptr;
+    this->adc = nullptr;
+    this->gcode_dispatch = nullptr;
+    this->stepper = nullptr;
+    this->simpleshell = nullptr;
+    this->configurator = nullptr;
+
+    this->streams = new StreamOutputPool();
+    this->streams->append_stream(&stdout_stream);
+
+    // the built in config.default unless we were given a config file
+    ConfigSource *source;
+    if(config_file.empty()) {
+        source= new FirmConfigSource("firm");
+    }else{
+        source= new FileConfigSource(config_file, "host");
+    }
+    this->config = new Config(new OverrideConfigSource(source));
+    this->config->config_cache_load();
+
+    this->current_path   = "/";
+
+    this->grbl_mode= this->config->value( grbl_mode_checksum )->by_default(false)->as_bool();
+    this->ok_per_line= this->config->value( ok_per_line_checksum )->by_default(true)->as_bool();
+
+    this->step_ticker = new StepTicker();
+    this->loop_latency = new LoopLatency();
+
+    // same priorities as the real Kernel, they decide the order host_hal_run() runs the handlers in
+    NVIC_SetPriorityGrouping(0);
+    NVIC_SetPriority(TIMER0_IRQn, 2);
+    NVIC_SetPriority(TIMER1_IRQn, 1);
+    NVIC_SetPriority(TIMER2_IRQn, 4);
+    NVIC_SetPriority(PendSV_IRQn, 3);
+    NVIC_SetPriority(RIT_IRQn, 3);
+
+    // Configure the step ticker
+    this->base_stepping_frequency = this->config->value(base_stepping_frequency_checksum)->by_default(100000)->as_number();
+    float microseconds_per_step_pulse = this->config->value(microseconds_per_step_pulse_checksum)->by_default(5)->as_number();
+    this->acceleration_ticks_per_second = THEKERNEL->config->value(acceleration_ticks_per_second_checksum)->by_default(1000)->as_number();
+
+    this->step_ticker->set_reset_delay( microseconds_per_step_pulse );
+    this->step_ticker->set_frequency( this->base_stepping_frequency );
+    this->step_ticker->set_acceleration_ticks_per_second(acceleration_ticks_per_second); // must be set after set_frequency
+    this->step_ticker->set_event_driven( this->config->value(event_driven_stepping_checksum)->by_default(false)->as_bool() );
+    this->step_ticker->set_amass_max_level( this->config->value(amass_max_level_checksum)->by_default(0)->as_int() ); // must be set after the frequency and reset delay
+
+    // Motion core modules
+    this->add_module( this->robot          = new Robot()         );
+    this->add_module( this->conveyor       = new Conveyor()      );
+
+    this->planner = new Planner();
+}
+
+// Add a module to Kernel. We don't actually hold a list of modules we just call its on_module_loaded
+void Kernel::add_module(Module* module){
+    module->on_module_loaded();
+}
+
+// Adds a hook for a given module and event
+void Kernel::register_for_event(_EVENT_ENUM id_event, Module *mod){
+    if(id_event == ON_GCODE_RECEIVED) {
+        // every line
+        this->gcode_handlers.add_all(mod);
+        return;
+    }
+    this->hooks[id_event].push_back(mod);
+}
+
+// Adds a module to the ones a G or M code is sent to on ON_GCODE_RECEIVED
+void Kernel::register_for_gcode(char letter, int code, Module *mod){
+    this->gcode_handlers.add(letter, code, mod);
+}
+
+// Call a specific event with an argument
+void Kernel::call_event(_EVENT_ENUM id_event, void * argument){
+    if(id_event == ON_HALT) {
+        this->halted= (argument == nullptr);
+    }
+    if(id_event == ON_GCODE_RECEIVED) {
+        Gcode *gcode= static_cast<Gcode *>(argument);
+        this->robot->queue_pending_segments_before(gcode);
+        this->gcode_handlers.dispatch(gcode);
+    }
+    for (auto m : hooks[id_event]) {
+        (m->*kernel_callback_functions[id_event])(argument);
+    }
+}
+
+bool Kernel::kernel_has_event(_EVENT_ENUM id_event, Module *mod)
+{
+    if(id_event == ON_GCODE_RECEIVED) return this->gcode_handlers.contains(mod);
+    for (auto m : hooks[id_event]) {
+        if(m == mod) return true;
+    }
+    return false;
+}
+
+void Kernel::unregister_for_event(_EVENT_ENUM id_event, Module *mod)
+{
+    if(id_event == ON_GCODE_RECEIVED) {
+        this->gcode_handlers.remove(mod);
+        return;
+    }
+    for (auto i = hooks[id_event].begin(); i != hooks[id_event].end(); ++i) {
+        if(*i == mod) {
+            hooks[id_event].erase(i);
+            return;
+        }
+    }
+}
+
+// The parts of GcodeDispatch the motion core depends on, strip comments and line numbers and split the line into single commands
+void host_dispatch_line(std::string line, std::function<void(Gcode&)> dispatch)
+{
+    static unsigned int modal_group_1= 0;
+
+    size_t comment = line.find_first_of(";(");
+    if(comment != std::string::npos) line= line.substr(0, comment);
+    while(!line.empty() && (line.back() == '\r' || line.back() == '\n' || line.back() == ' ')) line.pop_back();
+    size_t first= line.find_first_not_of(' ');
+    if(first == std::string::npos) return;
+    line= line.substr(first);
+
+    if(line[0] == 'N') {
+        size_t chkpos = line.find_first_of("*");
+        line= line.substr(0, chkpos);
+        size_t lnsize = line.find_first_not_of("N0123456789.,- ");
+        if(lnsize == std::string::npos) return;
+        line= line.substr(lnsize);
+    }
+
+    if(line.find_first_of("XYZF") == 0) {
+        // pycam style, use last modal group 1 command
+        line.insert(0, "G" + std::to_string(modal_group_1) + " ");
+    }
+
+    if(line[0] != 'G' && line[0] != 'M' && line[0] != 'T') return;
+
+    while(!line.empty()) {
+        // a G7 raster line ends with its pixels in base64, which can have any letter in them
+        bool raster= line.size() > 2 && line[0] == 'G' && line[1] == '7' && !isdigit(line[2]);
+        size_t nextcmd = raster ? std::string::npos : line.find_first_of("GM", 2);
+        std::string single_command;
+        if(nextcmd == std::string::npos) {
+            single_command= line;
+            line.clear();
+        }else{
+            single_command= line.substr(0, nextcmd);
+            line= line.substr(nextcmd);
+        }
+
+        Gcode gcode(single_command, &StreamOutput::NullStream);
+        if(gcode.has_g && gcode.g < 4) modal_group_1= gcode.g;
+        dispatch(gcode);
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "libs/StreamOutput.h"
+
+#include <functional>
+#include <string>
+#include <string.h>
+
+class Gcode;
+
+// use this config file instead of the built in config.default, must be called before the Kernel is created
+void host_kernel_set_config_file(const char *filename);
+
+// override a setting from the config, as if the line "setting value" was at the end of it, must be called before the Kernel is created
+void host_kernel_set_config_value(const char *setting, const char *value);
+
+// split a line of G-code into single commands like GcodeDispatch does and call dispatch with each one, which should
+// send it to the modules with ON_GCODE_RECEIVED
+void host_dispatch_line(std::string line, std::function<void(Gcode&)> dispatch);
+
+// StreamOutput that writes to the host stdout
+class StdoutStreamOutput : public StreamOutput {
+    public:
+        int puts(const char *str) { return fputs(str, stdout) < 0 ? 0 : strlen(str); }
+};
@@ -0,0 +1,66 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Host version of Pin, it parses the same pin strings as the real one but the GPIO ports are the fake ones in HostHal.cpp,
+every pin has a host PwmOut that only records what is written to it, there are no pin interrupts
+*/
+
+#include "Pin.h"
+#include "PwmOut.h"
+#include "utils.h"
+
+std::function<void(const mbed::PwmOut *, float)> mbed::PwmOut::write_hook;
+
+Pin::Pin(){
+    this->inverting= false;
+    this->valid= false;
+    this->pin= 32;
+    this->port= nullptr;
+}
+
+// Make a new pin object from a string
+Pin* Pin::from_string(std::string value){
+    LPC_GPIO_TypeDef* gpios[5] ={LPC_GPIO0,LPC_GPIO1,LPC_GPIO2,LPC_GPIO3,LPC_GPIO4};
+
+    this->valid= false;
+    if(value == "nc") return this;
+
+    const char* cs = value.c_str();
+    char* cn = NULL;
+    this->port_number = strtol(cs, &cn, 10);
+    if (cn <= cs || port_number > 4 || *cn != '.') return this;
+
+    cs = ++cn;
+    this->pin = strtol(cs, &cn, 10);
+    if (cn <= cs || pin >= 32) return this;
+
+    this->port = gpios[(unsigned int) this->port_number];
+    this->valid= true;
+    for (;*cn;cn++) {
+        if(*cn == '!') this->inverting = true;
+        else if(is_whitespace(*cn)) break;
+    }
+    return this;
+}
+
+Pin* Pin::as_open_drain(){ return this; }
+Pin* Pin::as_repeater(){ return this; }
+Pin* Pin::pull_none(){ return this; }
+Pin* Pin::pull_up(){ return this; }
+Pin* Pin::pull_down(){ return this; }
+
+mbed::PwmOut* Pin::hardware_pwm()
+{
+    if(!this->valid) return nullptr;
+    return new mbed::PwmOut(this->port_number, this->pin);
+}
+
+mbed::InterruptIn* Pin::interrupt_pin()
+{
+    return nullptr;
+}
@@ -0,0 +1,132 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Inverse kinematics benchmark for the host build.
+
+Converts the same points, the segment ends of helixes in front of the arm, to actuator positions with each arm solution
+that has a batch cartesian_to_actuators(), once a point at a time with cartesian_to_actuator() and once in batches the
+size Robot uses when it segments a line, and prints the mean time per point for each and the largest difference between
+the two.
+
+The arm solutions are built without -finstrument-functions for this tool, so the times are not skewed by the hooks
+planner_bench uses.
+
+Usage: ik_bench [-c config] [-n points] [-r rounds]
+*/
+
+#include "HostKernel.h"
+
+#include "libs/Kernel.h"
+#include "libs/Config.h"
+#include "modules/robot/arm_solutions/BaseSolution.h"
+#include "modules/robot/arm_solutions/LinearDeltaSolution.h"
+#include "modules/robot/arm_solutions/RotaryDeltaSolution.h"
+#include "modules/robot/arm_solutions/MorganSCARASolution.h"
+#include "ActuatorCoordinates.h"
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <vector>
+
+#define BATCH 8 // the same as SEGMENT_BATCH in Robot.cpp
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+// points on a helix of the given radius around x, y
+static std::vector<float> helix(size_t n, float x, float y, float radius)
+{
+    std::vector<float> points(n * 3);
+    for (size_t i = 0; i < n; ++i) {
+        float theta= i * 0.01F;
+        points[i * 3 + 0]= x + radius * cosf(theta);
+        points[i * 3 + 1]= y + radius * sinf(theta);
+        points[i * 3 + 2]= 10.0F + fmodf(i * 0.001F, 50.0F);
+    }
+    return points;
+}
+
+static void bench(const char *name, BaseSolution *solution, const std::vector<float>& points, int rounds)
+{
+    size_t n= points.size() / 3;
+    const float (*cartesian)[3]= reinterpret_cast<const float (*)[3]>(points.data());
+    std::vector<ActuatorCoordinates> single(n), batch(n);
+
+    uint64_t single_ns= 0, batch_ns= 0;
+    for (int r = 0; r < rounds; ++r) {
+        uint64_t start= now_ns();
+        for (size_t i = 0; i < n; ++i) {
+            solution->cartesian_to_actuator(cartesian[i], single[i]);
+        }
+        single_ns += now_ns() - start;
+
+        start= now_ns();
+        for (size_t i = 0; i < n; i += BATCH) {
+            solution->cartesian_to_actuators(&cartesian[i], &batch[i], std::min((size_t)BATCH, n - i));
+        }
+        batch_ns += now_ns() - start;
+    }
+
+    float worst= 0;
+    for (size_t i = 0; i < n; ++i) {
+        for (size_t a = 0; a < 3; ++a) {
+            float d= fabsf(single[i][a] - batch[i][a]);
+            if(d > worst || isnan(d)) worst= d;
+        }
+    }
+
+    double points_done= (double)n * rounds;
+    printf("%-14s single %7.2f ns, batch %7.2f ns per point, %1.2fx, largest difference %g mm\n",
+        name, single_ns / points_done, batch_ns / points_done, batch_ns > 0 ? (double)single_ns / batch_ns : 0, worst);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-n points] [-r rounds]\n", prog);
+    fprintf(stderr, "  -c config   use this config file instead of the built in config.default\n");
+    fprintf(stderr, "  -n points   number of points to convert, 100000 by default\n");
+    fprintf(stderr, "  -r rounds   number of times to convert them, 10 by default\n");
+}
+
+int main(int argc, char *argv[])
+{
+    size_t npoints= 100000;
+    int rounds= 10;
+    int c;
+    while((c= getopt(argc, argv, "c:n:r:h")) != -1) {
+        switch(c) {
+            case 'c': host_kernel_set_config_file(optarg); break;
+            case 'n': npoints= strtoul(optarg, nullptr, 10); break;
+            case 'r': rounds= atoi(optarg); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(npoints == 0 || rounds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // the solutions read their settings from the config, and use their defaults for the ones it does not have
+    new Kernel();
+    Config *config= THEKERNEL->config;
+
+    std::vector<float> delta_points= helix(npoints, 0, 0, 60);
+    std::vector<float> scara_points= helix(npoints, 100, 100, 40);
+
+    bench("linear delta", new LinearDeltaSolution(config), delta_points, rounds);
+    bench("rotary delta", new RotaryDeltaSolution(config), delta_points, rounds);
+    bench("morgan scara", new MorganSCARASolution(config), scara_points, rounds);
+
+    return 0;
+}
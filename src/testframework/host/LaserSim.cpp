@@ -0,0 +1,168 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Laser simulation for the host build.
+
+Runs G-code files through Robot, Planner, Conveyor, Stepper and the Laser module with the real StepTicker interrupt handlers
+on emulated timers, and logs every change of the laser PWM with the emulated time and the position of each actuator in
+steps. For the blocks of a G7 raster line it also works out which pixel the main stepper is over each time the power is
+written, and counts the writes where the laser is off over a pixel that is not 0 or on over one that is, so a pixel that
+starts a step early or late shows up. laser_module_minimum_power should be 0 for that count to mean anything.
+
+Usage: laser_sim [-c config] [-i us] [-q] file.gcode
+*/
+
+#include "HostKernel.h"
+#include "HostHal.h"
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "libs/StepperMotor.h"
+#include "libs/StepTicker.h"
+#include "system_LPC17xx.h"
+#include "modules/robot/Block.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/Stepper.h"
+#include "modules/tools/laser/Laser.h"
+#include "PwmOut.h"
+#include "Gcode.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// Stands in for the main loop taking some time, lets the emulated timers run whenever the modules are idle
+class EmulatedTime : public Module {
+    public:
+        EmulatedTime(uint64_t cycles) : cycles_per_idle(cycles) {}
+
+        void on_module_loaded()
+        {
+            register_for_event(ON_IDLE);
+        }
+
+        void on_idle(void *argument)
+        {
+            host_hal_run(cycles_per_idle);
+        }
+
+    private:
+        uint64_t cycles_per_idle;
+};
+
+static struct {
+    bool quiet;
+    float last;             // the last power written
+    uint32_t writes;
+    uint32_t raster_writes; // writes during a block of a G7
+    uint32_t wrong_pixel;   // and of those the ones where the laser was on over a 0 pixel or off over one that is not
+} laser_log;
+
+// the pixel of the current G7 block the main stepper is over, the last one that starts at or before the steps it has made
+static int current_pixel(const Block *block, const RasterSlice *raster, uint32_t stepped)
+{
+    uint64_t steps= block->steps_event_count, count= raster->pixel_count;
+    int pixel= 0;
+    while(pixel + 1 < raster->pixel_count && ((pixel + 1) * steps + count - 1) / count <= stepped) pixel++;
+    return raster->line->pixels()[raster->first_pixel + pixel];
+}
+
+static void on_pwm_write(const mbed::PwmOut *pwm, float power)
+{
+    laser_log.writes++;
+
+    const Block *block= THEKERNEL->stepper->get_current_block();
+    const RasterSlice *raster= block != nullptr ? block->get_raster() : nullptr;
+    if(raster != nullptr && raster->pixel_count > 0) {
+        laser_log.raster_writes++;
+        int pixel= current_pixel(block, raster, THEKERNEL->stepper->get_main_stepper()->get_stepped());
+        if((pixel == 0) != (power == 0.0F)) laser_log.wrong_pixel++;
+    }
+
+    if(laser_log.quiet || power == laser_log.last) return;
+    laser_log.last= power;
+
+    printf("%12.6f", host_hal_now() * 1000.0 / SystemCoreClock);
+    for (auto a : THEKERNEL->robot->actuators) {
+        printf(" %8ld", lroundf(a->get_current_position() * a->get_steps_per_mm()));
+    }
+    printf(" %6.4f\n", power);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-i us] [-q] file.gcode\n", prog);
+    fprintf(stderr, "  -c config   use this config file instead of the built in config.default\n");
+    fprintf(stderr, "  -i us       emulated time the main loop takes each time round, default 20us\n");
+    fprintf(stderr, "  -q          only print the summary, not each change of power\n");
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t us_per_idle= 20;
+    int c;
+    while((c= getopt(argc, argv, "c:i:qh")) != -1) {
+        switch(c) {
+            case 'c': host_kernel_set_config_file(optarg); break;
+            case 'i': us_per_idle= strtoul(optarg, NULL, 10); break;
+            case 'q': laser_log.quiet= true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind + 1 != argc || us_per_idle == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    FILE *fp= fopen(argv[optind], "r");
+    if(fp == NULL) {
+        fprintf(stderr, "Unable to open %s\n", argv[optind]);
+        return 1;
+    }
+
+    // the laser on the pin the sample configs use, the rest of its settings come from the config
+    host_kernel_set_config_value("laser_module_enable", "true");
+    host_kernel_set_config_value("laser_module_pin", "2.5");
+    new Kernel();
+    THEKERNEL->add_module( THEKERNEL->stepper = new Stepper() );
+    THEKERNEL->add_module( new Laser() );
+    THEKERNEL->add_module( new EmulatedTime((uint64_t)us_per_idle * (SystemCoreClock / 1000000)) );
+
+    laser_log.last= -1;
+    mbed::PwmOut::write_hook= on_pwm_write;
+    if(!laser_log.quiet) {
+        printf("%12s", "time ms");
+        for (size_t i = 0; i < THEKERNEL->robot->actuators.size(); ++i) printf("        %c", (char)('A' + i));
+        printf(" %6s\n", "power");
+    }
+
+    THEKERNEL->step_ticker->start();
+
+    char buf[512];
+    uint32_t nerrors= 0;
+    while(fgets(buf, sizeof(buf), fp) != NULL) {
+        host_dispatch_line(buf, [&](Gcode& gcode) {
+            THEKERNEL->call_event(ON_GCODE_RECEIVED, &gcode);
+            if(gcode.is_error) {
+                fprintf(stderr, "%s", buf);
+                fprintf(stderr, "error: %s\n", gcode.txt_after_ok.c_str());
+                nerrors++;
+            }
+            THEKERNEL->call_event(ON_MAIN_LOOP);
+            THEKERNEL->call_event(ON_IDLE);
+        });
+    }
+    fclose(fp);
+    THEKERNEL->conveyor->wait_for_empty_queue();
+
+    printf("%s: %lu gcode errors, %lu power changes, %lu in G7 blocks, %lu of them with the power of the wrong pixel\n", argv[optind],
+        (unsigned long)nerrors, (unsigned long)laser_log.writes, (unsigned long)laser_log.raster_writes, (unsigned long)laser_log.wrong_pixel);
+    return nerrors > 0 || laser_log.wrong_pixel > 0 ? 1 : 0;
+}
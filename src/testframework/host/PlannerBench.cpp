@@ -0,0 +1,226 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Planner throughput benchmark for the host build.
+
+Streams G-code files through Robot::on_gcode_received (and so Robot::append_line and Planner::append_block) as fast as
+the motion core can take them, and reports the number of blocks planned per second, how long Planner::recalculate() took
+for each appended block, how many blocks its reverse and forward passes walked and how many times the arm solution's cartesian_to_actuator() and cartesian_to_actuators() were
+called.
+
+The tail block is held as executing until the planner needs its slot, so once the queue has filled every new block is
+planned against a full queue, which is the steady state when streaming to a real machine.
+
+Usage: planner_bench [-c config] [-v] file.gcode ...
+*/
+
+#include "HostKernel.h"
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "modules/robot/Block.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/robot/Planner.h"
+#include "modules/robot/Robot.h"
+#include "modules/robot/arm_solutions/BaseSolution.h"
+#include "Gcode.h"
+
+#include <chrono>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+typedef std::chrono::steady_clock bench_clock;
+
+static inline uint64_t now_ns() __attribute__((no_instrument_function));
+static inline uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock::now().time_since_epoch()).count();
+}
+
+// Planner.cpp and the arm solutions are compiled with -finstrument-functions so we can time recalculate() and count
+// the IK calls without touching them
+static struct {
+    uint64_t start;
+    uint64_t total;
+    uint64_t worst;
+    uint32_t calls;
+    uint32_t worst_call;
+    uint32_t appended;
+    uint32_t ik_calls;
+    uint32_t ik_batches;
+    int depth;
+    uint32_t walked;        // reverse_pass() and forward_pass() calls in the current recalculate()
+    uint64_t total_walked;
+    uint32_t worst_walked;
+} recalc;
+
+static void *const recalculate_fn  = (void *)(&Planner::recalculate);
+static void *const append_block_fn = (void *)(&Planner::append_block);
+static void *const reverse_pass_fn = (void *)(&Block::reverse_pass);
+static void *const forward_pass_fn = (void *)(&Block::forward_pass);
+static void *ik_fn= nullptr; // set once the arm solution is known
+static void *ik_batch_fn= nullptr;
+
+extern "C" {
+void __cyg_profile_func_enter(void *fn, void *call_site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *fn, void *call_site) __attribute__((no_instrument_function));
+
+void __cyg_profile_func_enter(void *fn, void *call_site)
+{
+    if(fn == recalculate_fn) {
+        if(recalc.depth++ == 0) {
+            recalc.walked= 0;
+            recalc.start= now_ns();
+        }
+
+    }else if(fn == reverse_pass_fn || fn == forward_pass_fn) {
+        recalc.walked++;
+
+    }else if(fn == append_block_fn) {
+        recalc.appended++;
+
+    }else if(fn == ik_fn) {
+        recalc.ik_calls++;
+
+    }else if(fn == ik_batch_fn) {
+        recalc.ik_batches++;
+    }
+}
+
+void __cyg_profile_func_exit(void *fn, void *call_site)
+{
+    if(fn == recalculate_fn && --recalc.depth == 0) {
+        uint64_t t= now_ns() - recalc.start;
+        recalc.total += t;
+        recalc.calls++;
+        if(t > recalc.worst) {
+            recalc.worst= t;
+            recalc.worst_call= recalc.calls;
+        }
+        recalc.total_walked += recalc.walked;
+        if(recalc.walked > recalc.worst_walked) recalc.worst_walked= recalc.walked;
+    }
+}
+}
+
+// Stands in for Stepper, takes each block that moves and only finishes it when the planner is waiting for a free slot
+class BlockConsumer : public Module {
+    public:
+        BlockConsumer() : current(nullptr), draining(false) {}
+
+        void on_module_loaded()
+        {
+            register_for_event(ON_BLOCK_BEGIN);
+            register_for_event(ON_IDLE);
+        }
+
+        void on_block_begin(void *argument)
+        {
+            Block *block= static_cast<Block *>(argument);
+            if(block->millimeters > 0.0F) {
+                block->take();
+                current= block;
+            }
+        }
+
+        // registered after the Conveyor so it has already garbage collected the finished blocks when we get here
+        void on_idle(void *argument)
+        {
+            if(current == nullptr) return;
+            if(!draining && !THEKERNEL->conveyor->is_queue_full()) return;
+
+            Block *block= current;
+            current= nullptr;
+            block->release();
+        }
+
+        Block *current;
+        bool draining;
+};
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-v] file.gcode ...\n", prog);
+    fprintf(stderr, "  -c config   use this config file instead of the built in config.default\n");
+    fprintf(stderr, "  -v          print progress while running\n");
+}
+
+int main(int argc, char *argv[])
+{
+    bool verbose= false;
+    int c;
+    while((c= getopt(argc, argv, "c:vh")) != -1) {
+        switch(c) {
+            case 'c': host_kernel_set_config_file(optarg); break;
+            case 'v': verbose= true; break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    new Kernel();
+    BlockConsumer *consumer= new BlockConsumer();
+    THEKERNEL->add_module(consumer);
+
+    // the virtual cartesian_to_actuator() and cartesian_to_actuators() of the configured arm solution
+    BaseSolution *solution= THEKERNEL->robot->arm_solution;
+    ik_fn= (void *)(solution->*(&BaseSolution::cartesian_to_actuator));
+    ik_batch_fn= (void *)(solution->*(&BaseSolution::cartesian_to_actuators));
+
+    int ret= 0;
+    for (int f = optind; f < argc; ++f) {
+        FILE *fp= fopen(argv[f], "r");
+        if(fp == NULL) {
+            fprintf(stderr, "Unable to open %s\n", argv[f]);
+            ret= 1;
+            continue;
+        }
+
+        memset(&recalc, 0, sizeof(recalc));
+        uint32_t nlines= 0, ngcodes= 0, nerrors= 0;
+        char buf[256];
+
+        uint64_t start= now_ns();
+        while(fgets(buf, sizeof(buf), fp) != NULL) {
+            host_dispatch_line(buf, [&](Gcode& gcode) {
+                // anything other than a move may wait for the queue to empty so let blocks finish
+                consumer->draining= !(gcode.has_g && gcode.g < 4);
+                THEKERNEL->call_event(ON_GCODE_RECEIVED, &gcode);
+                ngcodes++;
+                if(gcode.is_error) nerrors++;
+            });
+            ++nlines;
+            if(verbose && (nlines % 10000) == 0) fprintf(stderr, "%s: %lu lines\r", argv[f], (unsigned long)nlines);
+        }
+        consumer->draining= true;
+        THEKERNEL->conveyor->wait_for_empty_queue();
+        uint64_t elapsed= now_ns() - start;
+        fclose(fp);
+
+        double secs= elapsed / 1e9;
+        printf("%s\n", argv[f]);
+        printf("  lines: %lu, gcodes: %lu, errors: %lu\n", (unsigned long)nlines, (unsigned long)ngcodes, (unsigned long)nerrors);
+        printf("  blocks planned: %lu in %1.3f s, %1.0f blocks/s\n", (unsigned long)recalc.appended, secs, secs > 0 ? recalc.appended / secs : 0);
+        printf("  cartesian_to_actuator(): %lu calls, %1.2f per block, cartesian_to_actuators(): %lu calls\n", (unsigned long)recalc.ik_calls,
+            recalc.appended > 0 ? (double)recalc.ik_calls / recalc.appended : 0, (unsigned long)recalc.ik_batches);
+        if(recalc.calls > 0) {
+            printf("  recalculate(): mean %1.3f us, worst %1.3f us (block %lu), %1.1f%% of the time\n",
+                recalc.total / 1e3 / recalc.calls, recalc.worst / 1e3, (unsigned long)recalc.worst_call, 100.0 * recalc.total / elapsed);
+            printf("  blocks walked per recalculate(): mean %1.2f, worst %lu, queue of %u\n",
+                (double)recalc.total_walked / recalc.calls, (unsigned long)recalc.worst_walked, THEKERNEL->conveyor->get_queue_size());
+        }
+    }
+
+    return ret;
+}
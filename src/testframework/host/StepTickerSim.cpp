@@ -0,0 +1,324 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Step generation simulation for the host build.
+
+Runs G-code files through Robot, Planner, Conveyor, Stepper and the real StepTicker interrupt handlers on emulated timers,
+once for each way the step generation can be set up, and compares them with the first, which is the fixed frequency ticker
+at 100kHz with the speeds worked out in the acceleration tick.
+Every step pin that is set is recorded with the emulated time it happened at, so for each actuator the n-th step of one run
+is compared with the n-th step of the other, and the TIMER0 interrupts are counted by how many motors they stepped.
+
+Each run is done in its own process as the Kernel and the modules can only be created once.
+
+Usage: stepticker_sim [-c config] [-i us] file.gcode ...
+*/
+
+#include "HostKernel.h"
+#include "HostHal.h"
+
+#include "libs/Kernel.h"
+#include "libs/Module.h"
+#include "libs/Pin.h"
+#include "libs/StepTicker.h"
+#include "libs/Config.h"
+#include "system_LPC17xx.h"
+#include "modules/robot/Conveyor.h"
+#include "modules/robot/Stepper.h"
+#include "modules/robot/ActuatorCoordinates.h"
+#include "checksumm.h"
+#include "ConfigValue.h"
+#include "Gcode.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define alpha_step_pin_checksum  CHECKSUM("alpha_step_pin")
+#define beta_step_pin_checksum   CHECKSUM("beta_step_pin")
+#define gamma_step_pin_checksum  CHECKSUM("gamma_step_pin")
+
+// the config settings for each run
+static const struct {
+    const char *name;
+    const char *event_driven_stepping;
+    const char *prepare_step_segments;
+    const char *base_stepping_frequency;
+    const char *amass_max_level;
+} modes[]= {
+    { "fixed:",          "false", "false", "100000", "0" },
+    { "event driven:",   "true",  "false", "100000", "0" },
+    { "segments:",       "false", "true",  "100000", "0" },
+    { "event+segments:", "true",  "true",  "100000", "0" },
+    { "fixed 25kHz:",    "false", "false", "25000",  "0" },
+    { "amass 25kHz:",    "false", "false", "25000",  "2" },
+};
+static const size_t num_modes= sizeof(modes) / sizeof(modes[0]);
+
+// what one run recorded
+struct SimResult {
+    uint64_t cycles;                                 // emulated time taken to run the file
+    uint64_t ticks;                                  // base ticks counted by the StepTicker
+    uint32_t underruns;                              // acceleration ticks that had no prepared segment
+    uint32_t interrupts[k_max_actuators + 1];        // TIMER0 interrupts, by the number of motors they stepped
+    std::vector<uint64_t> steps[k_max_actuators];    // the emulated time of each step in cycles
+
+    bool write(FILE *fp) const;
+    bool read(FILE *fp);
+};
+
+bool SimResult::write(FILE *fp) const
+{
+    if(fwrite(&cycles, sizeof(cycles), 1, fp) != 1) return false;
+    if(fwrite(&ticks, sizeof(ticks), 1, fp) != 1) return false;
+    if(fwrite(&underruns, sizeof(underruns), 1, fp) != 1) return false;
+    if(fwrite(interrupts, sizeof(interrupts), 1, fp) != 1) return false;
+    for (auto& s : steps) {
+        uint64_t n= s.size();
+        if(fwrite(&n, sizeof(n), 1, fp) != 1) return false;
+        if(n > 0 && fwrite(s.data(), sizeof(uint64_t), n, fp) != n) return false;
+    }
+    return true;
+}
+
+bool SimResult::read(FILE *fp)
+{
+    if(fread(&cycles, sizeof(cycles), 1, fp) != 1) return false;
+    if(fread(&ticks, sizeof(ticks), 1, fp) != 1) return false;
+    if(fread(&underruns, sizeof(underruns), 1, fp) != 1) return false;
+    if(fread(interrupts, sizeof(interrupts), 1, fp) != 1) return false;
+    for (auto& s : steps) {
+        uint64_t n;
+        if(fread(&n, sizeof(n), 1, fp) != 1) return false;
+        s.resize(n);
+        if(n > 0 && fread(s.data(), sizeof(uint64_t), n, fp) != n) return false;
+    }
+    return true;
+}
+
+// Stands in for the main loop taking some time, lets the emulated timers run whenever the modules are idle
+class EmulatedTime : public Module {
+    public:
+        EmulatedTime(uint64_t cycles) : cycles_per_idle(cycles) {}
+
+        void on_module_loaded()
+        {
+            register_for_event(ON_IDLE);
+        }
+
+        void on_idle(void *argument)
+        {
+            host_hal_run(cycles_per_idle);
+        }
+
+    private:
+        uint64_t cycles_per_idle;
+};
+
+// run one file in the given mode, in a process of its own
+static bool run(const char *file, size_t mode, uint32_t us_per_idle, SimResult& result)
+{
+    FILE *fp= fopen(file, "r");
+    if(fp == NULL) {
+        fprintf(stderr, "Unable to open %s\n", file);
+        return false;
+    }
+
+    host_kernel_set_config_value("event_driven_stepping", modes[mode].event_driven_stepping);
+    host_kernel_set_config_value("prepare_step_segments", modes[mode].prepare_step_segments);
+    host_kernel_set_config_value("base_stepping_frequency", modes[mode].base_stepping_frequency);
+    host_kernel_set_config_value("amass_max_level", modes[mode].amass_max_level);
+    new Kernel();
+    THEKERNEL->add_module( THEKERNEL->stepper = new Stepper() );
+    THEKERNEL->add_module( new EmulatedTime((uint64_t)us_per_idle * (SystemCoreClock / 1000000)) );
+
+    // the step pins are watched like a logic analyser would
+    const uint16_t step_pin_checksums[]= { alpha_step_pin_checksum, beta_step_pin_checksum, gamma_step_pin_checksum };
+    Pin step_pins[k_max_actuators];
+    for (size_t i = 0; i < k_max_actuators && i < 3; ++i) {
+        step_pins[i].from_string(THEKERNEL->config->value(step_pin_checksums[i])->by_default("nc")->as_string())->as_output();
+    }
+    if(std::none_of(step_pins, step_pins + k_max_actuators, [](Pin& p) { return p.connected(); })) {
+        fprintf(stderr, "No step pins are configured, give a board config file with -c\n");
+        return false;
+    }
+
+    memset(result.interrupts, 0, sizeof(result.interrupts));
+    result.ticks= 0;
+    uint32_t tick_cnt_before= 0;
+    host_hal_set_irq_hooks(
+        [&](IRQn_Type irq) {
+            if(irq != TIMER0_IRQn) return;
+            tick_cnt_before= THEKERNEL->step_ticker->get_tick_cnt();
+            // forget the pins written since the last step interrupt, unsteps and enables
+            for (int i = 0; i < 5; ++i) {
+                host_lpc_gpio[i].FIOSET.bits= 0;
+                host_lpc_gpio[i].FIOCLR.bits= 0;
+            }
+        },
+        [&](IRQn_Type irq) {
+            if(irq != TIMER0_IRQn) return;
+            result.ticks += THEKERNEL->step_ticker->get_tick_cnt() - tick_cnt_before;
+
+            int stepped= 0;
+            for (size_t i = 0; i < k_max_actuators; ++i) {
+                Pin& p= step_pins[i];
+                if(!p.connected()) continue;
+                uint32_t written= p.is_inverting() ? p.port->FIOCLR.bits : p.port->FIOSET.bits;
+                if(written & (1 << p.pin)) {
+                    result.steps[i].push_back(host_hal_now());
+                    stepped++;
+                }
+            }
+            result.interrupts[stepped]++;
+        });
+
+    THEKERNEL->step_ticker->start();
+
+    char buf[256];
+    while(fgets(buf, sizeof(buf), fp) != NULL) {
+        host_dispatch_line(buf, [](Gcode& gcode) {
+            THEKERNEL->call_event(ON_GCODE_RECEIVED, &gcode);
+            THEKERNEL->call_event(ON_MAIN_LOOP);
+            THEKERNEL->call_event(ON_IDLE);
+        });
+    }
+    fclose(fp);
+
+    THEKERNEL->conveyor->wait_for_empty_queue();
+    result.cycles= host_hal_now();
+    result.underruns= THEKERNEL->stepper->get_segment_underruns();
+    return true;
+}
+
+// run in a child process and pass the result back through a temporary file
+static bool run_child(const char *file, size_t mode, uint32_t us_per_idle, SimResult& result)
+{
+    FILE *tmp= tmpfile();
+    if(tmp == NULL) return false;
+
+    fflush(stdout);
+    pid_t pid= fork();
+    if(pid == 0) {
+        // stdout from the firmware would get mixed up with the report
+        if(freopen("/dev/null", "w", stdout) == NULL) _exit(1);
+        bool ok= run(file, mode, us_per_idle, result) && result.write(tmp);
+        fflush(tmp);
+        _exit(ok ? 0 : 1);
+    }
+
+    int status;
+    if(pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fclose(tmp);
+        return false;
+    }
+    rewind(tmp);
+    bool ok= result.read(tmp);
+    fclose(tmp);
+    return ok;
+}
+
+static void print_interrupts(size_t mode, const SimResult& r)
+{
+    uint64_t total= 0, steps= 0;
+    for (size_t i = 0; i <= k_max_actuators; ++i) {
+        total += r.interrupts[i];
+        steps += i * r.interrupts[i];
+    }
+    // the figures for the fixed ticker measured on the LPC1768, 1.2us when nothing steps and about 0.65us more for each motor stepped
+    float isr_us= total * 1.2F + steps * 0.65F;
+    float secs= r.cycles / (float)SystemCoreClock;
+
+    printf("  %-16s %8.3f s, %10llu ticks (%1.3f us each), %10llu interrupts, %10llu stepped nothing (%5.1f%%), est. ISR load %5.1f%%, %lu segment underruns\n",
+        modes[mode].name, secs, (unsigned long long)r.ticks, r.ticks > 0 ? secs * 1e6F / r.ticks : 0.0F,
+        (unsigned long long)total, (unsigned long long)r.interrupts[0], total > 0 ? 100.0F * r.interrupts[0] / total : 0.0F,
+        secs > 0 ? isr_us / 1e4F / secs : 0.0F, (unsigned long)r.underruns);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-c config] [-i us] file.gcode ...\n", prog);
+    fprintf(stderr, "  -c config   use this config file instead of the built in config.default\n");
+    fprintf(stderr, "  -i us       emulated time the main loop takes each time round, default 20us\n");
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t us_per_idle= 20;
+    int c;
+    while((c= getopt(argc, argv, "c:i:h")) != -1) {
+        switch(c) {
+            case 'c': host_kernel_set_config_file(optarg); break;
+            case 'i': us_per_idle= strtoul(optarg, NULL, 10); break;
+            default: usage(argv[0]); return 1;
+        }
+    }
+    if(optind >= argc || us_per_idle == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int ret= 0;
+    for (int f = optind; f < argc; ++f) {
+        SimResult results[num_modes];
+        size_t m;
+        for (m = 0; m < num_modes; ++m) {
+            if(!run_child(argv[f], m, us_per_idle, results[m])) break;
+        }
+        if(m < num_modes) {
+            fprintf(stderr, "%s: simulation failed\n", argv[f]);
+            ret= 1;
+            continue;
+        }
+
+        printf("%s\n", argv[f]);
+        for (m = 0; m < num_modes; ++m) {
+            print_interrupts(m, results[m]);
+        }
+
+        // each mode against the first, in microseconds
+        const double cycles_per_us= SystemCoreClock / 1e6;
+        for (m = 1; m < num_modes; ++m) {
+            printf("  %s\n", modes[m].name);
+            for (size_t i = 0; i < k_max_actuators; ++i) {
+                const std::vector<uint64_t>& a= results[0].steps[i];
+                const std::vector<uint64_t>& b= results[m].steps[i];
+                if(a.empty() && b.empty()) continue;
+
+                size_t n= std::min(a.size(), b.size());
+                uint64_t same= 0, worst= 0, worst_interval= 0;
+                double sum= 0, sum_interval= 0;
+                for (size_t s = 0; s < n; ++s) {
+                    uint64_t d= a[s] > b[s] ? a[s] - b[s] : b[s] - a[s];
+                    if(d < cycles_per_us) same++;
+                    if(d > worst) worst= d;
+                    sum += d;
+                    if(s > 0) {
+                        // the time since the previous step, which shows a difference in speed even after the steps have drifted apart
+                        int64_t di= (int64_t)(a[s] - a[s - 1]) - (int64_t)(b[s] - b[s - 1]);
+                        sum_interval += llabs(di);
+                        if((uint64_t)llabs(di) > worst_interval) worst_interval= llabs(di);
+                    }
+                }
+                printf("    actuator %c: %8lu / %8lu steps, %5.1f%% within 1us, deviation mean %1.2f worst %1.2f us, interval mean %1.3f worst %1.2f us\n",
+                    (char)('A' + i), (unsigned long)a.size(), (unsigned long)b.size(), n > 0 ? 100.0 * same / n : 100.0,
+                    n > 0 ? sum / n / cycles_per_us : 0.0, worst / cycles_per_us,
+                    n > 1 ? sum_interval / (n - 1) / cycles_per_us : 0.0, worst_interval / cycles_per_us);
+                if(a.size() != b.size()) ret= 1;
+            }
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,8 @@
+#ifndef MBED_PINNAMES_H
+#define MBED_PINNAMES_H
+
+typedef enum {
+    USBTX, USBRX, NC = (int)0xFFFFFFFF
+} PinName;
+
+#endif
@@ -0,0 +1,35 @@
+#ifndef MBED_PWMOUT_H
+#define MBED_PWMOUT_H
+
+#include "cmsis.h"
+
+#include <functional>
+
+namespace mbed {
+
+// Host PwmOut, it keeps the duty cycle it was given and calls write_hook with it so a host tool can record the output
+class PwmOut {
+    public:
+        PwmOut(int port, int pin) : port(port), pin(pin), value(0), period(20) {}
+
+        void write(float v)
+        {
+            value= v < 0.0F ? 0.0F : (v > 1.0F ? 1.0F : v);
+            if(write_hook) write_hook(this, value);
+        }
+        float read() { return value; }
+        void period_us(int us) { period= us; }
+
+        static std::function<void(const PwmOut *, float)> write_hook;
+
+        const int port;
+        const int pin;
+
+    private:
+        float value;
+        int period;
+};
+
+}
+
+#endif
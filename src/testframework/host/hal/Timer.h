@@ -0,0 +1,6 @@
+#ifndef MBED_TIMER_H
+#define MBED_TIMER_H
+
+#include "us_ticker_api.h"
+
+#endif
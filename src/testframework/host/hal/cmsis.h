@@ -0,0 +1 @@
+#include "libs/LPC17xx/sLPC17xx.h"
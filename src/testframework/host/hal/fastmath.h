@@ -0,0 +1,4 @@
+// newlib's fastmath.h, glibc's math.h has everything it provides
+#pragma once
+
+#include <math.h>
@@ -0,0 +1,186 @@
+/*
+      This file is part of Smoothie (http://smoothieware.org/). The motion control part is heavily based on Grbl (https://github.com/simen/grbl).
+      Smoothie is free software: you can redistribute it and/or modify it under the terms of the GNU General Public License as published by the Free Software Foundation, either version 3 of the License, or (at your option) any later version.
+      Smoothie is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+      You should have received a copy of the GNU General Public License along with Smoothie. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/**
+Host replacement for the LPC17xx peripheral access layer.
+The peripherals the motion core touches are plain structs in memory so the firmware sources compile unchanged on the host,
+the host test harness can then look at (and act on) what the firmware wrote to them.
+*/
+
+#ifndef __LPC17xx_H__
+#define __LPC17xx_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum IRQn {
+    NonMaskableInt_IRQn   = -14,
+    MemoryManagement_IRQn = -12,
+    BusFault_IRQn         = -11,
+    UsageFault_IRQn       = -10,
+    SVCall_IRQn           = -5,
+    DebugMonitor_IRQn     = -4,
+    PendSV_IRQn           = -2,
+    SysTick_IRQn          = -1,
+    WDT_IRQn              = 0,
+    TIMER0_IRQn           = 1,
+    TIMER1_IRQn           = 2,
+    TIMER2_IRQn           = 3,
+    TIMER3_IRQn           = 4,
+    UART0_IRQn            = 5,
+    UART1_IRQn            = 6,
+    UART2_IRQn            = 7,
+    UART3_IRQn            = 8,
+    ADC_IRQn              = 22,
+    USB_IRQn              = 24,
+    RIT_IRQn              = 29,
+    HOST_NUMBER_OF_IRQn   = 35
+} IRQn_Type;
+
+// FIOSET and FIOCLR keep every bit written to them until the host clears them, so a host tool can see every pin the
+// firmware set or cleared, even when several were written one after the other in the same interrupt
+typedef struct {
+    uint32_t bits;
+    void operator=(uint32_t v) { bits |= v; }
+} host_latch_reg;
+
+typedef struct {
+    volatile uint32_t FIODIR;
+    uint32_t RESERVED0[3];
+    volatile uint32_t FIOMASK;
+    volatile uint32_t FIOPIN;
+    host_latch_reg FIOSET;
+    host_latch_reg FIOCLR;
+} LPC_GPIO_TypeDef;
+
+// writing TCR with the reset bit set clears the timer counter like the real one does
+typedef struct {
+    uint32_t value;
+    inline void operator=(uint32_t v);
+    operator uint32_t() const { return value; }
+} host_tcr_reg;
+
+typedef struct {
+    volatile uint32_t IR;
+    host_tcr_reg TCR;
+    volatile uint32_t TC;
+    volatile uint32_t PR;
+    volatile uint32_t PC;
+    volatile uint32_t MCR;
+    volatile uint32_t MR0;
+    volatile uint32_t MR1;
+    volatile uint32_t MR2;
+    volatile uint32_t MR3;
+    volatile uint32_t CCR;
+    volatile uint32_t CR0;
+    volatile uint32_t CR1;
+    volatile uint32_t EMR;
+    volatile uint32_t CTCR;
+} LPC_TIM_TypeDef;
+
+inline void host_tcr_reg::operator=(uint32_t v)
+{
+    value= v;
+    if(v & 2) {
+        LPC_TIM_TypeDef *tim= (LPC_TIM_TypeDef *)((char *)this - offsetof(LPC_TIM_TypeDef, TCR));
+        tim->TC= 0;
+        tim->PC= 0;
+    }
+}
+
+typedef struct {
+    volatile uint32_t RICOMPVAL;
+    volatile uint32_t RIMASK;
+    volatile uint32_t RICTRL;
+    volatile uint32_t RICOUNTER;
+} LPC_RIT_TypeDef;
+
+typedef struct {
+    volatile uint32_t PCONP;
+    volatile uint32_t PCLKSEL0;
+    volatile uint32_t PCLKSEL1;
+} LPC_SC_TypeDef;
+
+typedef struct {
+    volatile uint32_t WDMOD;
+    volatile uint32_t WDTC;
+    volatile uint32_t WDFEED;
+    volatile uint32_t WDTV;
+    volatile uint32_t WDCLKSEL;
+} LPC_WDT_TypeDef;
+
+typedef struct {
+    volatile uint32_t ICSR;
+} SCB_Type;
+
+// the cycle counter counts the host's own time at SystemCoreClock, so what it times is how long the code took on the host
+typedef struct {
+    operator uint32_t() const;
+} host_cyccnt_reg;
+
+typedef struct {
+    volatile uint32_t CTRL;
+    host_cyccnt_reg CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+extern LPC_GPIO_TypeDef host_lpc_gpio[5];
+extern LPC_TIM_TypeDef  host_lpc_tim[4];
+extern LPC_RIT_TypeDef  host_lpc_rit;
+extern LPC_SC_TypeDef   host_lpc_sc;
+extern LPC_WDT_TypeDef  host_lpc_wdt;
+extern SCB_Type         host_scb;
+extern DWT_Type         host_dwt;
+extern CoreDebug_Type   host_coredebug;
+
+#define LPC_GPIO0 (&host_lpc_gpio[0])
+#define LPC_GPIO1 (&host_lpc_gpio[1])
+#define LPC_GPIO2 (&host_lpc_gpio[2])
+#define LPC_GPIO3 (&host_lpc_gpio[3])
+#define LPC_GPIO4 (&host_lpc_gpio[4])
+#define LPC_TIM0  (&host_lpc_tim[0])
+#define LPC_TIM1  (&host_lpc_tim[1])
+#define LPC_TIM2  (&host_lpc_tim[2])
+#define LPC_TIM3  (&host_lpc_tim[3])
+#define LPC_RIT   (&host_lpc_rit)
+#define LPC_SC    (&host_lpc_sc)
+#define LPC_WDT   (&host_lpc_wdt)
+#define SCB       (&host_scb)
+#define DWT       (&host_dwt)
+#define CoreDebug (&host_coredebug)
+
+#define SCB_ICSR_PENDSVSET_Msk (1UL << 28)
+#define DWT_CTRL_CYCCNTENA_Msk (1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk (1UL << 24)
+
+void NVIC_SetPriorityGrouping(uint32_t PriorityGroup);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t NVIC_GetPriority(IRQn_Type IRQn);
+void NVIC_SystemReset(void);
+
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+static inline uint32_t __get_PRIMASK(void) { return 0; }
+static inline void __set_PRIMASK(uint32_t priMask) {}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // __LPC17xx_H__
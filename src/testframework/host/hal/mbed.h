@@ -0,0 +1,10 @@
+#ifndef MBED_H
+#define MBED_H
+
+#include "libs/LPC17xx/sLPC17xx.h"
+#include "system_LPC17xx.h"
+#include "us_ticker_api.h"
+#include "wait_api.h"
+#include "PinNames.h"
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef _MRI_H_
+#define _MRI_H_
+
+#include <stdlib.h>
+
+// on the target this traps into the MRI debug monitor, on the host there is nothing to trap into so stop
+static inline void __debugbreak(void) { abort(); }
+
+#endif
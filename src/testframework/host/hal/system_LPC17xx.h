@@ -0,0 +1,16 @@
+#ifndef __SYSTEM_LPC17xx_H
+#define __SYSTEM_LPC17xx_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern uint32_t SystemCoreClock; // 100MHz on a Smoothieboard
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -60,3 +60,80 @@ TEST(GCodeTest,subcode)
     ASSERT_EQUALS_DELTA_V(2.3, gc4.get_value('Y'), 0.001);
 
 }
+
+TEST(GCodeTest,parsed_values)
+{
+    // moves only keep the parsed values
+    Gcode gc1("G1 X1.5 Y-2 Z0.25 E1e-2 F3000", nullptr);
+    ASSERT_TRUE(gc1.has_g);
+    ASSERT_EQUALS_V(1, gc1.g);
+    ASSERT_EQUALS_V(0, (int)strlen(gc1.get_command()));
+    ASSERT_EQUALS_V(5, gc1.get_num_args());
+    ASSERT_EQUALS_DELTA_V(1.5, gc1.get_value('X'), 0.001);
+    ASSERT_EQUALS_DELTA_V(-2.0, gc1.get_value('Y'), 0.001);
+    ASSERT_EQUALS_DELTA_V(0.25, gc1.get_value('Z'), 0.001);
+    ASSERT_EQUALS_DELTA_V(0.01, gc1.get_value('E'), 0.0001);
+    ASSERT_EQUALS_V(3000, gc1.get_int('F'));
+    ASSERT_TRUE(!gc1.has_letter('G'));
+    ASSERT_TRUE(!gc1.has_letter('S'));
+    ASSERT_EQUALS_DELTA_V(0.0, gc1.get_value('S'), 0.001);
+
+    // the attached copy loses XYZIJK but keeps the rest
+    Gcode gc2(gc1);
+    gc2.strip_parameters();
+    ASSERT_TRUE(!gc2.has_letter('X'));
+    ASSERT_TRUE(!gc2.has_letter('Z'));
+    ASSERT_EQUALS_V(2, gc2.get_num_args());
+    ASSERT_EQUALS_DELTA_V(0.01, gc2.get_value('E'), 0.0001);
+    ASSERT_EQUALS_DELTA_V(3000.0, gc2.get_value('F'), 0.001);
+
+    // letters without a value, and the first occurrence with a value is used
+    Gcode gc3("G28 X Y Y5 Y6", nullptr);
+    ASSERT_TRUE(gc3.has_letter('X'));
+    ASSERT_EQUALS_DELTA_V(0.0, gc3.get_value('X'), 0.001);
+    ASSERT_EQUALS_DELTA_V(5.0, gc3.get_value('Y'), 0.001);
+    ASSERT_EQUALS_V(2, gc3.get_num_args());
+
+    // more letters than are parsed are found in the text
+    Gcode gc4("G1 A1 B2 C3 D4 E5 F6 H7 I8 J9 K10", nullptr);
+    ASSERT_EQUALS_DELTA_V(1.0, gc4.get_value('A'), 0.001);
+    ASSERT_EQUALS_DELTA_V(9.0, gc4.get_value('J'), 0.001);
+    ASSERT_EQUALS_DELTA_V(10.0, gc4.get_value('K'), 0.001);
+    ASSERT_TRUE(gc4.has_letter('K'));
+    ASSERT_EQUALS_V(10, gc4.get_num_args());
+
+    // other commands keep their text, and integers are read from it
+    Gcode gc5("M907 X1 S16777217", nullptr);
+    ASSERT_TRUE(gc5.has_m);
+    ASSERT_EQUALS_V(907, gc5.m);
+    ASSERT_TRUE(strcmp(gc5.get_command(), " X1 S16777217") == 0);
+    ASSERT_EQUALS_V(16777217, gc5.get_int('S'));
+
+    // an unstripped line can be searched for anything
+    Gcode gc6("N10 G1 X1*85", nullptr, false);
+    ASSERT_EQUALS_V(10, gc6.get_int('N'));
+    ASSERT_EQUALS_V(85, (int)gc6.get_value('*'));
+}
+
+TEST(GCodeTest,shared_text)
+{
+    Gcode *gc1= new Gcode("M84 X1", nullptr);
+    Gcode gc2(*gc1);
+    Gcode gc3("M17", nullptr);
+    gc3= gc2;
+
+    // copies share the text, and it stays after the original is gone
+    ASSERT_TRUE(gc1->get_command() == gc2.get_command());
+    ASSERT_TRUE(gc1->get_command() == gc3.get_command());
+    delete gc1;
+    ASSERT_TRUE(strcmp(gc2.get_command(), " X1") == 0);
+    ASSERT_TRUE(strcmp(gc3.get_command(), " X1") == 0);
+
+    // stripping a copy does not change the others
+    Gcode gc4("G1 A1 B2 C3 D4 E5 F6 H7 X8 Y9", nullptr);
+    Gcode gc5(gc4);
+    gc5.strip_parameters();
+    ASSERT_TRUE(strcmp(gc5.get_command(), " A1 B2 C3 D4 E5 F6 H7  ") == 0);
+    ASSERT_EQUALS_DELTA_V(9.0, gc4.get_value('Y'), 0.001);
+    ASSERT_TRUE(!gc5.has_letter('Y'));
+}